@@ -1,103 +1,153 @@
 ﻿#include <zmq.hpp>
 #include <string>
 #include <iostream>
-#include <Windows.h>
+#include <vector>
 #include <queue>
+#include <set>
+#include <deque>
+#include <cstdlib>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "ServerConnection.h"
+#include "MessageTokenizer.h"
+#include "ClientProtocol.h"
+#include "Rules.h"
 
-std::string userGameName; // Name of game room
 std::string login; // User login
-std::string uniqueID; // Unique sequence for every user
-std::queue<std::string> savedMessages; // Additional messages from server 
-std::vector<std::vector<int>> myField, enemyField; // Represents game field
+const int kPollTimeout = 25000; // How long server holds poll of network thread, ms
+Tiles myField, enemyField; // Represents game field
+
+const int kGamesPerListPage = 20; // Games in one game list request
+std::set<std::string> knownGames; // Open games, updated by changes since known version
+uint64_t knownGameListVersion = 0;
+bool hasGameList = false;
 
 zmq::context_t context(1); // Context for ZMQ
-zmq::socket_t messageSocket(context, zmq::socket_type::req);  // Socket for messages
-
-
-// Split string with delimiter
-std::vector<std::string> splitString(std::string request, std::string delimiter) {
-    std::vector<std::string> messages;
-    if (request.find(delimiter) != std::string::npos) {
-        int position = request.find(delimiter);
-        do {
-            messages.push_back(request.substr(0, position));
-            request = request.substr(position + 1, request.length() - position);
-            position = request.find(delimiter);
-        } while (position != std::string::npos);
-        messages.push_back(request);
-    }
-    else 
-        messages.push_back(request);
-    return messages;
-}
+Session session(context); // Connection to server for requests of main thread
+
+// Events for main thread. Input thread adds words typed by user, network thread adds messages
+// from server as soon as they come. Main thread sleeps until event, so idle client uses no CPU
+std::mutex eventsMutex;
+std::condition_variable eventsCondition;
+std::deque<std::string> inputWords, serverMessages;
 
 // ===========================================================================================
 // 
-//                      Client - Server messaging
+//                                       Events
 // 
 // ===========================================================================================
 
-// Get message from saved messages
-std::string getSavedMessage() {
-    if (savedMessages.empty())
-        return "";
+// Input thread. Reads words typed by user
+void inputThread() {
+    std::string word;
+    while (std::cin >> word) {
+        eventsMutex.lock();
+        inputWords.push_back(word);
+        eventsMutex.unlock();
+        eventsCondition.notify_one();
+    }
 
-    std::string message = savedMessages.front();
-    savedMessages.pop();
-    return message;
+    // Input is closed. Client exits without waiting for network thread
+    std::cout << std::endl;
+    std::cout.flush();
+    std::_Exit(0);
 }
 
-// Send request and split respond into some messages. Get direct respond for request.               
-std::string getServerRespond(const std::string& request) {
-    zmq::message_t message(request);
-    messageSocket.send(message, zmq::send_flags::none);
-    messageSocket.recv(message, zmq::recv_flags::none);
+// Network thread. Keeps long poll on server with own socket, so messages come without requests
+void networkThread(std::string endpoint) {
+    Session pollSession(context);
+    pollSession.useBinaryProtocol = session.useBinaryProtocol;
+    pollSession.uniqueID = session.uniqueID;
+    pollSession.uniqueNumber = session.uniqueNumber;
+    pollSession.socket.connect(endpoint);
 
-    std::string respond = message.to_string();
-    std::vector<std::string> messages = splitString(respond, std::string(1, kMessageDelimiter));
+    while (true) {
+        std::string message = getNextMessage(pollSession, kPollTimeout);
+        if (message.empty())
+            continue;
 
-    // Logging
-    //if (respond != "N")
-    //    std::cout << "Get respond [" << respond << "]" << std::endl;
+        eventsMutex.lock();
+        serverMessages.push_back(message);
+        eventsMutex.unlock();
+        eventsCondition.notify_one();
+    }
+}
 
-    for (int i = 1; i < messages.size(); ++i)
-        savedMessages.push(messages[i]);
+// Waits for message from server or word typed by user. Returns true if it is message.
+// Messages saved from responds to main thread requests go first
+bool waitEvent(std::string& text) {
+    text = getSavedMessage(session);
+    if (!text.empty())
+        return true;
 
-    if (messages[0] == std::string(1, kNothing)) 
-        return getSavedMessage();
+    std::unique_lock<std::mutex> lock(eventsMutex);
+    eventsCondition.wait(lock, [] { return !serverMessages.empty() || !inputWords.empty(); });
+    std::deque<std::string>& events = serverMessages.empty() ? inputWords : serverMessages;
+    bool isMessage = !serverMessages.empty();
+    text = events.front();
+    events.pop_front();
+    return isMessage;
+}
 
-    return messages[0];
+// Waits for word typed by user. Messages wait in queue
+std::string readWord() {
+    std::unique_lock<std::mutex> lock(eventsMutex);
+    eventsCondition.wait(lock, [] { return !inputWords.empty(); });
+    std::string word = inputWords.front();
+    inputWords.pop_front();
+    return word;
 }
 
-// Get next message without request. If there are saved messages, then returns them first
-std::string getNextMessage() {
-    std::string respond = getSavedMessage();
-    if (respond.empty()) {
-        std::string request = std::string(1, kNothing) + std::string(1, kMessagePartsDelimiter) + uniqueID;
-        respond = getServerRespond(request);
-    }
-    return respond;
+// Waits for number typed by user. Returns -1 if it is not a number
+int readNumber() {
+    std::string word = readWord();
+    char* end;
+    long number = std::strtol(word.c_str(), &end, 10);
+    return *end == '\0' ? (int)number : -1;
 }
- 
+
+// Waits for message from server. Words typed meanwhile wait in queue
+std::string waitMessage() {
+    std::string message = getSavedMessage(session);
+    if (!message.empty())
+        return message;
+
+    std::unique_lock<std::mutex> lock(eventsMutex);
+    eventsCondition.wait(lock, [] { return !serverMessages.empty(); });
+    message = serverMessages.front();
+    serverMessages.pop_front();
+    return message;
+}
+
+// Drops words typed before prompt
+void clearInput() {
+    eventsMutex.lock();
+    inputWords.clear();
+    eventsMutex.unlock();
+}
+
+
+// ===========================================================================================
+// 
+//                      Client - Server messaging
+// 
+// ===========================================================================================
+
 // Login procedure
 void doLogin() {
     std::cout << "Please enter your login: ";
-    std::cin >> login;
-    std::string request = std::string(1, kLogin) + std::string(1, kMessagePartsDelimiter) + login;
-
-    std::string respond = getServerRespond(request);
+    login = readWord();
+    std::string respond = getServerRespond(session, loginRequest(session, login));
 
     while (respond[0] != kLogin) {
         std::cout << "This login has been already taken. Please try another one: ";
-        std::cin >> login;
-        request = std::string(1, kLogin) + std::string(1, kMessagePartsDelimiter) + login;
-
-        respond = getServerRespond(request);
+        login = readWord();
+        respond = getServerRespond(session, loginRequest(session, login));
     }
 
-    uniqueID = respond.substr(2, respond.length() - 2);
+    setSessionUser(session, respond);
     std::cout << "Login success!" << std::endl << std::endl;
 }
 
@@ -107,12 +157,22 @@ void doLogin() {
 //
 // ===========================================================================================
 
-// Convert char field symbols to int analog
-int mapSymbolToNumber(char symbol) {
-    switch (symbol) {
-    case '.': return 0;
-    case '@': return 1;
-    default: return -1;
+// Print why server didn't accept field
+void printFieldError(const std::string& respond) {
+    int code = respond.size() > 2 ? std::atoi(respond.c_str() + 2) : 0;
+    switch (code) {
+    case kFieldWrongShape:
+        std::cout << "Wrong field: ships must be straight lines." << std::endl;
+        break;
+    case kFieldShipsTouch:
+        std::cout << "Wrong field: ships must not touch each other." << std::endl;
+        break;
+    case kFieldWrongFleet:
+        std::cout << "Wrong field: fleet must be 1 ship of 4 cells, 2 of 3, 3 of 2 and 4 of 1." << std::endl;
+        break;
+    default:
+        std::cout << "Wrong field." << std::endl;
+        break;
     }
 }
 
@@ -122,62 +182,43 @@ void createField() {
 
     std::vector<std::string> field(10);
     for (int i = 0; i < 10; ++i) 
-        std::cin >> field[i];
+        field[i] = readWord();
 
-    std::string request = std::string(1, kFieldCheck) + std::string(1, kMessagePartsDelimiter) + uniqueID
-        + std::string(1, kMessagePartsDelimiter) + userGameName;
-    for (int i = 0; i < 10; ++i) 
-        request += std::string(1, kMessagePartsDelimiter) + field[i];
-    
-    std::string respond = getServerRespond(request);
+    std::string request = fieldRequest(session, field);
+    std::string respond = request.empty() ? std::string(1, kFailure) : getServerRespond(session, request);
 
     while (respond[0] != kFieldCheck) {
-        std::cout << "Wrong field. Try another one:" << std::endl;
+        printFieldError(respond);
+        std::cout << "Try another one:" << std::endl;
 
         field = std::vector<std::string>(10);
         for (int i = 0; i < 10; ++i) 
-            std::cin >> field[i];
+            field[i] = readWord();
         
-        request = std::string(1, kFieldCheck) + std::string(1, kMessagePartsDelimiter) + uniqueID
-            + std::string(1, kMessagePartsDelimiter) + userGameName;
-        for (int i = 0; i < 10; ++i) 
-            request += std::string(1, kMessagePartsDelimiter) + field[i];
-        
-        respond = getServerRespond(request);
+        request = fieldRequest(session, field);
+        respond = request.empty() ? std::string(1, kFailure) : getServerRespond(session, request);
     }
 
-    myField = std::vector<std::vector<int>>(10, std::vector<int>(10));
-    for (int row = 0; row < 10; ++row) 
-        for (int column = 0; column < 10; ++column) 
+    for (int row = 0; row < kFieldSize; ++row) 
+        for (int column = 0; column < kFieldSize; ++column) {
             myField[row][column] = mapSymbolToNumber(field[row][column]);
+            enemyField[row][column] = kUnknownTile;
+        }
 
-    enemyField = std::vector<std::vector<int>>(10, std::vector<int>(10, 4));
     std::cout << "Waiting for other player to finish." << std::endl;
 }
 
-// Convert int analog to char field symbols
-char numberToMapSymbol(int number) {
-    switch (number) {
-    case 0: return ' ';
-    case 1: return '@';
-    case 2: return '*';
-    case 3: return '.';
-    case 4: return '?';
-    default: return '!';
-    }
-}
-
 // Print fields in console
 void printGameField() {
     std::cout << std::endl;
     std::cout << "0123456789   0123456789" << std::endl << std::endl;
 
-    for (int row = 0; row < 10; ++row) {
-        for (int column = 0; column < 10; ++column) 
+    for (int row = 0; row < kFieldSize; ++row) {
+        for (int column = 0; column < kFieldSize; ++column) 
             std::cout << numberToMapSymbol(myField[row][column]);
 
         std::cout << " " << row << " ";
-        for (int column = 0; column < 10; ++column) 
+        for (int column = 0; column < kFieldSize; ++column) 
             std::cout << numberToMapSymbol(enemyField[row][column]);
 
         std::cout << std::endl;
@@ -201,50 +242,11 @@ void printWinner(const std::string& message) {
     std::cout << "Exiting to menu..." << std::endl << std::endl;
 }
 
-// Check if coordinate are correct
-bool correctCoordinate(int number) {
-    return number >= 0 && number < 10;
-}
-
-// Mark all fields around destroyed ship
-void destroyShip(std::vector<std::vector<int>>& field, int row, int column) {
-    std::queue<std::pair<int, int>> queue, editedTiles;
-    queue.push(std::pair<int, int>(row, column));
-    field[row][column] = 2;
-
-    int dColumn[8] = { -1,  0,  1, -1, 1, -1, 0, 1 };
-    int dRow[8] = { -1, -1, -1,  0, 0,  1, 1, 1 };
-    while (!queue.empty()) {
-        int tileRow = queue.front().first, tileColumn = queue.front().second;
-        queue.pop();
-
-        if (field[tileRow][tileColumn] == 0 || field[tileRow][tileColumn] == 4) {
-            field[tileRow][tileColumn] = kDamagedSea;
-            continue;
-        }
-
-        if (field[tileRow][tileColumn] == 2) {
-            editedTiles.push(std::pair<int, int>(tileRow, tileColumn));
-            field[tileRow][tileColumn] = kUnknownTile;
-
-            for (int i = 0; i < 8; ++i)
-                if (correctCoordinate(tileColumn + dColumn[i]) && correctCoordinate(tileRow + dRow[i]))
-                    queue.push(std::pair<int, int>(tileRow + dRow[i], tileColumn + dColumn[i]));
-        }
-    }
-
-    while (!editedTiles.empty()) {
-        int tileRow = editedTiles.front().first, tileColumn = editedTiles.front().second;
-        editedTiles.pop();
-        field[tileRow][tileColumn] = kDamagedShip;
-    }
-}
-
 // Handle enemy move. Return true if enemy is still moving.
 bool hadleEnemyMove(const std::string& message) {
     int row = message[2] - '0', column = message[3] - '0', result = message[4] - '0';
     if (result == kDestroyed)
-        destroyShip(myField, row, column);
+        markDestroyedShip(myField, row, column);
     else
         myField[row][column] = result;
 
@@ -256,47 +258,52 @@ bool hadleEnemyMove(const std::string& message) {
     return false;
 }
 
-// Do your move
-void makeMove() {
+// Do your move. Returns false if server rejected move: it isn't player's turn, cell is shot or game is gone
+bool makeMove() {
     int row, column, result;
 
+    // Words typed during enemy's move are dropped
+    clearInput();
     do {
         std::cout << "Enter coordinates of shot: ";
-        std::cin >> row >> column;
-
-        while (enemyField[row][column] != 4) {
-            std::cout << "You alredy shot there! Enter another coordinates: ";
-            std::cin >> row >> column;
+        row = readNumber();
+        column = readNumber();
+
+        while (!correctCoordinate(row) || !correctCoordinate(column) || enemyField[row][column] != kUnknownTile) {
+            if (correctCoordinate(row) && correctCoordinate(column))
+                std::cout << "You alredy shot there! Enter another coordinates: ";
+            else
+                std::cout << "Coordinates are 0..9. Enter another coordinates: ";
+            row = readNumber();
+            column = readNumber();
         }
 
-        std::string message = std::string(1, kDoAction) + std::string(1, kMessagePartsDelimiter)
-            + uniqueID + std::string(1, kMessagePartsDelimiter) + userGameName + std::string(1, kMessagePartsDelimiter)
-            + std::string(1, row + '0') + std::string(1, column + '0');
-
-        message = getServerRespond(message);
+        std::string message = getServerRespond(session, moveRequest(session, row, column));
 
         if (message[0] == kGameEnd) {
-            savedMessages.push(message);
-            return;
+            session.savedMessages.push(message);
+            return true;
+        }
+
+        if (message[0] == kFailure || message.size() < 3) {
+            std::cout << "Move was rejected: it is not your turn, cell is already shot or game is gone." << std::endl;
+            return false;
         }
 
         result = message[2] - '0';
         if (result == kDestroyed)
-            destroyShip(enemyField, row, column);
+            markDestroyedShip(enemyField, row, column);
         else 
             enemyField[row][column] = result;
         printGameField();
 
 
-        message = getSavedMessage();
-        while (message != "") {
-            if (message[0] == kGameEnd) {
-                savedMessages.push(message);
-                return;
-            }
-            message = getSavedMessage();
-        }
+        // Game could end by this shot. Other messages, like moves of bot, are handled after it
+        for (std::queue<std::string> messages = session.savedMessages; !messages.empty(); messages.pop())
+            if (messages.front()[0] == kGameEnd)
+                return true;
     } while (result == kDamagedShip || result == kDestroyed);
+    return true;
 }
 
 
@@ -307,17 +314,19 @@ void playGame() {
 
     std::string message;
     while (true) {
-        message = getNextMessage();
+        message = waitMessage();
 
         if (message[0] == kStartGame) {
-            if (message[2] == 'Y')
-                makeMove();
+            if (message[2] == 'Y' && !makeMove()) {
+                std::cout << "Returning to menu." << std::endl << std::endl;
+                return;
+            }
             break;
         }
     }
 
     while (true) {
-        message = getNextMessage();
+        message = waitMessage();
 
         if (message[0] == kGameEnd) {
             printWinner(message);
@@ -327,7 +336,10 @@ void playGame() {
         if (message[0] == kEnemyAction) {
             if (hadleEnemyMove(message))
                 continue;
-            makeMove();
+            if (!makeMove()) {
+                std::cout << "Returning to menu." << std::endl << std::endl;
+                break;
+            }
         }
     }
 }
@@ -347,15 +359,10 @@ void printLobbyMenu() {
 
 // Procedure of sending invite to player
 void invitePlayerToGame() {
-    std::string login;
     std::cout << "Enter user login: ";
-    std::cin >> login;
-
-    std::string message = std::string(1, kInvitePlayer) + std::string(1, kMessagePartsDelimiter)
-        + uniqueID + std::string(1, kMessagePartsDelimiter) + login + std::string(1, kMessagePartsDelimiter)
-        + userGameName;
+    std::string login = readWord();
 
-    message = getServerRespond(message);
+    std::string message = getServerRespond(session, inviteRequest(session, login));
 
     if (message[0] == kFailure) {
         std::cout << "There is no such user." << std::endl << std::endl;
@@ -365,27 +372,32 @@ void invitePlayerToGame() {
     std::cout << "Invite was sent." << std::endl << std::endl;
 }
 
-// Game lobby procedure
+// Game lobby procedure. Player who joins is shown at once, even while user is choosing command
 void gameLobby() {
-    int command;
-    std::string message;
+    printLobbyMenu();
+    bool needPrompt = true;
+    std::string event;
     while (true) {
-        message = getNextMessage();
-
-        if (message[0] == kPlayerJoinYourGame) {
-            std::cout << "Player " << message.substr(2, message.length() - 2) << " joined your game."
-                << std::endl << std::endl;
-            playGame();
-            break;
+        if (needPrompt)
+            std::cout << "You are in game lobby. Enter number of command: ";
+        needPrompt = true;
+
+        if (waitEvent(event)) {
+            if (event[0] == kPlayerJoinYourGame) {
+                std::cout << std::endl << "Player " << event.substr(2, event.length() - 2) << " joined your game."
+                    << std::endl << std::endl;
+                playGame();
+                break;
+            }
+            needPrompt = false;
+            continue;
         }
 
-        printLobbyMenu();
-
-        std::cout << "You are in game lobby. Enter number of command: ";
-        std::cin >> command;
-
+        int command = std::atoi(event.c_str());
         if (command == 1) 
             invitePlayerToGame();
+        else if (command == 2)
+            printLobbyMenu();
     }
 }
 
@@ -398,34 +410,78 @@ void gameLobby() {
 // Creating new game lobby
 void createNewGame() {
     std::cout << "Enter game's name : ";
-    std::string gameName;
-    std::cin >> gameName;
-
-    std::string message = std::string(1, kCreateGame) + std::string(1, kMessagePartsDelimiter)
-        + uniqueID + std::string(1, kMessagePartsDelimiter) + gameName;
+    std::string gameName = readWord();
 
-    message = getServerRespond(message);
+    std::string message = getServerRespond(session, createGameRequest(session, gameName));
 
     if (message[0] == kFailure) {
         std::cout << "Failed to create game. This name is already taken." << std::endl << std::endl;
         return;
     }
 
-    userGameName = gameName;
+    session.gameName = gameName;
+    session.gameID = getRespondGameID(message);
     std::cout << "The lobby created successfully." << std::endl << std::endl;
 
     gameLobby();
 }
 
+// Load whole game list page by page
+void loadGameList() {
+    knownGames.clear();
+    int cursor = 0;
+    bool isFirstPage = true;
+    do {
+        std::string message = getServerRespond(session, gameListRequest(session, cursor, kGamesPerListPage));
+        if (message[0] != kGetGameList)
+            return;
+
+        std::string_view gameList = message;
+        takeMessagePart(gameList, kMessagePartsDelimiter);
+        uint64_t version = std::stoull(std::string(takeMessagePart(gameList, kMessagePartsDelimiter)));
+        cursor = std::atoi(std::string(takeMessagePart(gameList, kMessagePartsDelimiter)).c_str());
+
+        // List could change while loading pages, these changes come with next refresh
+        if (isFirstPage)
+            knownGameListVersion = version;
+        isFirstPage = false;
+
+        while (!gameList.empty())
+            knownGames.insert(std::string(takeMessagePart(gameList, kMessagePartsDelimiter)));
+    } while (cursor != 0);
+    hasGameList = true;
+}
+
+// Apply game list changes since known version. Returns false if list should be reloaded
+bool refreshGameList() {
+    std::string message = getServerRespond(session, gameListChangesRequest(session, knownGameListVersion));
+    if (message[0] != kGameListChanges)
+        return false;
+
+    std::string_view changes = message;
+    takeMessagePart(changes, kMessagePartsDelimiter);
+    knownGameListVersion = std::stoull(std::string(takeMessagePart(changes, kMessagePartsDelimiter)));
+    while (!changes.empty()) {
+        std::string_view change = takeMessagePart(changes, kMessagePartsDelimiter);
+        if (change.empty())
+            continue;
+
+        if (change[0] == '+')
+            knownGames.insert(std::string(change.substr(1)));
+        else
+            knownGames.erase(std::string(change.substr(1)));
+    }
+    return true;
+}
+
 // Getting list of available games
 void viewGameList() {
-    std::string message = std::string(1, kGetGameList) + std::string(1, kMessagePartsDelimiter)  + uniqueID;
-    message = getServerRespond(message);
+    if (!hasGameList || !refreshGameList())
+        loadGameList();
 
-    std::vector<std::string> gameList = splitString(message, std::string(1, kMessagePartsDelimiter));
     std::cout << "List of available games: " << std::endl;
-    for (int i = 1; i < gameList.size(); ++i) 
-        std::cout << gameList[i] << ";" << std::endl;
+    for (const std::string& game : knownGames)
+        std::cout << game << ";" << std::endl;
 
     std::cout << std::endl;
 }
@@ -435,15 +491,12 @@ void joinGame(const std::string& name) {
     std::string message, gameName;
     if (name.empty()) {
         std::cout << "Enter name of game you want to join: ";
-        std::cin >> gameName;
+        gameName = readWord();
     }
     else 
         gameName = name;
     
-    message = std::string(1, kJoinGame) + std::string(1, kMessagePartsDelimiter) + uniqueID
-        + std::string(1, kMessagePartsDelimiter) + gameName;
-
-    message = getServerRespond(message);
+    message = getServerRespond(session, joinGameRequest(session, gameName));
 
     if (message[0] == kFailure) {
         std::cout << "Unable to join game. Game lobby are full or game does not exist."
@@ -451,22 +504,42 @@ void joinGame(const std::string& name) {
         return;
     }
 
-    userGameName = gameName;
+    session.gameName = gameName;
+    session.gameID = getRespondGameID(message);
     std::cout << "You are joining game " << gameName << "." << std::endl << std::endl;
 
     playGame();
 }
 
+// Game with bot of server procedure
+void playWithBot() {
+    std::cout << "Enter game's name : ";
+    std::string gameName = readWord();
+
+    std::string message = getServerRespond(session, playBotRequest(session, gameName));
+
+    if (message[0] == kFailure) {
+        std::cout << "Failed to create game. This name is already taken." << std::endl << std::endl;
+        return;
+    }
+
+    session.gameName = gameName;
+    session.gameID = getRespondGameID(message);
+    std::cout << "Bot joined your game." << std::endl << std::endl;
+
+    playGame();
+}
+
 // Handle invite from other player
 void handleInvite(const std::string& message) {
-    std::vector<std::string> splitedString = splitString(message, std::string(1, kMessagePartsDelimiter));
+    MessageParts parts;
+    if (!splitMessage(message, kMessagePartsDelimiter, parts) || parts.size != 3)
+        return;
 
-    std::cout << splitedString[1] << " invite you to game: " << splitedString[2] << std::endl;
+    std::cout << parts.part[1] << " invite you to game: " << parts.part[2] << std::endl;
     std::cout << "'A' - accept, anything else - decline: " << std::endl;
-    std::string answer;
-    std::cin >> answer;
-    if (answer == "A") 
-       joinGame(splitedString[2]);
+    if (readWord() == "A") 
+       joinGame(std::string(parts.part[2]));
 }
 
 // Print main menu 
@@ -476,35 +549,54 @@ void printBaseMenu() {
     std::cout << "2. View game list;" << std::endl;
     std::cout << "3. Join game;" << std::endl;
     std::cout << "4. Print menu;" << std::endl;
-    std::cout << "5. Refresh terminal." << std::endl << std::endl;
+    std::cout << "5. Refresh terminal;" << std::endl;
+    std::cout << "6. Play with bot." << std::endl << std::endl;
 }
 
 
 
 
 
-int main() {
+int main(int argc, char* argv[]) {
     std::cout << "===========================================" << std::endl;
     std::cout << "          Welcome to Sea Battle game       " << std::endl;
     std::cout << "===========================================" << std::endl;
 
-    messageSocket.connect(kServerPort);
+    // Client uses binary protocol if started with --binary, server is set by --endpoint
+    std::string endpoint = kServerPort;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--binary")
+            session.useBinaryProtocol = true;
+        else if (i + 1 < argc && argument == "--endpoint")
+            endpoint = argv[++i];
+    }
+
+    session.socket.connect(endpoint);
+    std::thread(inputThread).detach();
     doLogin();
+    std::thread(networkThread, endpoint).detach();
 
+    // Invite is shown at once, even while user is choosing command
     printBaseMenu();
-    int command;
+    bool needPrompt = true;
+    std::string event;
     while (true) {
-        std::string message = getNextMessage();
-
-        if (message[0] == kInvitePlayer) {
-            handleInvite(message);
+        if (needPrompt)
+            std::cout << "You are in game menu. Enter number of command: ";
+        needPrompt = true;
+
+        if (waitEvent(event)) {
+            if (event[0] == kInvitePlayer) {
+                std::cout << std::endl;
+                handleInvite(event);
+            }
+            else
+                needPrompt = false;
             continue;
         }
 
-        std::cout << "You are in game menu. Enter number of command: ";
-        std::cin >> command;
-
-        switch (command) {
+        switch (std::atoi(event.c_str())) {
         case 1:
             createNewGame();
             break;
@@ -517,6 +609,9 @@ int main() {
         case 4:
             printBaseMenu();
             break;
+        case 6:
+            playWithBot();
+            break;
         }
     }
 }
@@ -0,0 +1,296 @@
+#include <cstring>
+#include <cstdlib>
+
+#include "ClientProtocol.h"
+#include "ServerConnection.h"
+#include "BinaryProtocol.h"
+#include "MessageTokenizer.h"
+#include "Rules.h"
+
+structSession::structSession(zmq::context_t& context, bool pipelined)
+    : socket(context, pipelined ? zmq::socket_type::dealer : zmq::socket_type::req) {
+    isPipelined = pipelined;
+    useBinaryProtocol = false;
+    uniqueNumber = 0;
+    gameID = 0;
+    lastRequestID = 0;
+}
+
+// ===========================================================================================
+// 
+//                                  Request builders
+// 
+// ===========================================================================================
+
+// Build request in binary protocol
+std::string binaryRequest(const Session& session, char type, int gameID, const void* payload = nullptr,
+    size_t payloadSize = 0) {
+    std::string request(kBinaryHeaderSize + payloadSize, '\0');
+    fillBinaryHeader(&request[0], type, session.uniqueNumber, gameID);
+    if (payloadSize != 0)
+        std::memcpy(&request[kBinaryHeaderSize], payload, payloadSize);
+    return request;
+}
+
+// Build login request
+std::string loginRequest(const Session& session, const std::string& login) {
+    if (session.useBinaryProtocol)
+        return binaryRequest(session, kLogin, 0, login.data(), login.size());
+    return std::string(1, kLogin) + std::string(1, kMessagePartsDelimiter) + login;
+}
+
+// Build create game request
+std::string createGameRequest(const Session& session, const std::string& gameName) {
+    if (session.useBinaryProtocol)
+        return binaryRequest(session, kCreateGame, 0, gameName.data(), gameName.size());
+    return std::string(1, kCreateGame) + std::string(1, kMessagePartsDelimiter)
+        + session.uniqueID + std::string(1, kMessagePartsDelimiter) + gameName;
+}
+
+// Build game list request. Limit 0 - whole list, otherwise page of games after cursor
+std::string gameListRequest(const Session& session, int cursor, int limit) {
+    if (session.useBinaryProtocol) {
+        uint32_t page[2] = { (uint32_t)cursor, (uint32_t)limit };
+        return binaryRequest(session, kGetGameList, 0, limit > 0 ? page : nullptr, limit > 0 ? kGameListPageSize : 0);
+    }
+
+    std::string request = std::string(1, kGetGameList) + std::string(1, kMessagePartsDelimiter) + session.uniqueID;
+    if (limit > 0)
+        request += std::string(1, kMessagePartsDelimiter) + std::to_string(cursor)
+            + std::string(1, kMessagePartsDelimiter) + std::to_string(limit);
+    return request;
+}
+
+// Build request of game list changes since version
+std::string gameListChangesRequest(const Session& session, uint64_t version) {
+    if (session.useBinaryProtocol)
+        return binaryRequest(session, kGameListChanges, 0, &version, kGameListVersionSize);
+    return std::string(1, kGameListChanges) + std::string(1, kMessagePartsDelimiter) + session.uniqueID
+        + std::string(1, kMessagePartsDelimiter) + std::to_string(version);
+}
+
+// Build join game request
+std::string joinGameRequest(const Session& session, const std::string& gameName) {
+    if (session.useBinaryProtocol)
+        return binaryRequest(session, kJoinGame, 0, gameName.data(), gameName.size());
+    return std::string(1, kJoinGame) + std::string(1, kMessagePartsDelimiter) + session.uniqueID
+        + std::string(1, kMessagePartsDelimiter) + gameName;
+}
+
+// Build request of game with bot
+std::string playBotRequest(const Session& session, const std::string& gameName) {
+    if (session.useBinaryProtocol)
+        return binaryRequest(session, kPlayBot, 0, gameName.data(), gameName.size());
+    return std::string(1, kPlayBot) + std::string(1, kMessagePartsDelimiter) + session.uniqueID
+        + std::string(1, kMessagePartsDelimiter) + gameName;
+}
+
+// Build invite request for session's game
+std::string inviteRequest(const Session& session, const std::string& login) {
+    if (session.useBinaryProtocol)
+        return binaryRequest(session, kInvitePlayer, session.gameID, login.data(), login.size());
+    return std::string(1, kInvitePlayer) + std::string(1, kMessagePartsDelimiter)
+        + session.uniqueID + std::string(1, kMessagePartsDelimiter) + login + std::string(1, kMessagePartsDelimiter)
+        + session.gameName;
+}
+
+// Build game field request. Returns empty string if field can't be packed for binary protocol
+std::string fieldRequest(const Session& session, const std::vector<std::string>& field) {
+    if (session.useBinaryProtocol) {
+        uint8_t bitmap[kFieldBitmapSize] = {};
+        for (int row = 0; row < 10; ++row) {
+            if (field[row].size() != 10)
+                return "";
+
+            for (int column = 0; column < 10; ++column) {
+                int tile = mapSymbolToNumber(field[row][column]);
+                if (tile == -1)
+                    return "";
+                if (tile == kShip)
+                    setFieldBit(bitmap, row, column);
+            }
+        }
+        return binaryRequest(session, kFieldCheck, session.gameID, bitmap, kFieldBitmapSize);
+    }
+
+    std::string request = std::string(1, kFieldCheck) + std::string(1, kMessagePartsDelimiter) + session.uniqueID
+        + std::string(1, kMessagePartsDelimiter) + session.gameName;
+    for (int i = 0; i < 10; ++i) 
+        request += std::string(1, kMessagePartsDelimiter) + field[i];
+    return request;
+}
+
+// Build move request
+std::string moveRequest(const Session& session, int row, int column) {
+    if (session.useBinaryProtocol) {
+        uint8_t move[kMoveSize] = { (uint8_t)row, (uint8_t)column };
+        return binaryRequest(session, kDoAction, session.gameID, move, kMoveSize);
+    }
+    return std::string(1, kDoAction) + std::string(1, kMessagePartsDelimiter)
+        + session.uniqueID + std::string(1, kMessagePartsDelimiter) + session.gameName
+        + std::string(1, kMessagePartsDelimiter) + std::string(1, row + '0') + std::string(1, column + '0');
+}
+
+// Build poll request. With timeout server holds request until message arrives or timeout expires
+std::string pollRequest(const Session& session, int timeout) {
+    if (session.useBinaryProtocol) {
+        uint32_t pollTimeout = timeout;
+        return binaryRequest(session, kNothing, session.gameID, timeout > 0 ? &pollTimeout : nullptr,
+            timeout > 0 ? kPollTimeoutSize : 0);
+    }
+
+    std::string request = std::string(1, kNothing) + std::string(1, kMessagePartsDelimiter) + session.uniqueID;
+    if (timeout > 0)
+        request += std::string(1, kMessagePartsDelimiter) + std::to_string(timeout);
+    return request;
+}
+
+// ===========================================================================================
+// 
+//                                Client - Server messaging
+// 
+// ===========================================================================================
+
+// Convert binary respond to the same form as text respond
+std::string decodeBinaryRespond(const zmq::message_t& message) {
+    if (!isBinaryFrame(message.data(), message.size()))
+        return std::string(1, kFailure);
+
+    BinaryHeader header = readBinaryHeader(message.data());
+    std::string respond(1, header.type);
+    switch (header.type) {
+    case kLogin:
+        respond += std::string(1, kMessagePartsDelimiter) + std::to_string(header.uniqueID);
+        break;
+    case kCreateGame:
+    case kJoinGame:
+    case kPlayBot:
+        respond += std::string(1, kMessagePartsDelimiter) + std::to_string(header.gameID);
+        break;
+    case kDoAction:
+        respond += std::string(1, kMessagePartsDelimiter) + std::string(1, header.result + '0');
+        break;
+    case kFailure:
+        if (header.result != 0)
+            respond += std::string(1, kMessagePartsDelimiter) + std::to_string(header.result);
+        break;
+    default:
+        respond.append(static_cast<const char*>(message.data()) + kBinaryHeaderSize, message.size() - kBinaryHeaderSize);
+        break;
+    }
+    return respond;
+}
+
+// Remember UID from login respond
+void setSessionUser(Session& session, const std::string& respond) {
+    session.uniqueID = respond.substr(2, respond.length() - 2);
+    session.uniqueNumber = std::stoull(session.uniqueID);
+}
+
+// Gets game ID from create or join respond
+int getRespondGameID(const std::string& respond) {
+    if (respond.size() < 3)
+        return 0;
+    return std::atoi(respond.c_str() + 2);
+}
+
+// Get message from saved messages
+std::string getSavedMessage(Session& session) {
+    if (session.savedMessages.empty())
+        return "";
+
+    std::string message = session.savedMessages.front();
+    session.savedMessages.pop();
+    return message;
+}
+
+// Split respond into direct respond and saved messages. Binary respond has saved messages in next frames
+std::string splitRespond(Session& session, zmq::message_t& message) {
+    if (session.useBinaryProtocol) {
+        std::string respond = decodeBinaryRespond(message);
+        while (message.more()) {
+            session.socket.recv(message, zmq::recv_flags::none);
+            session.savedMessages.push(message.to_string());
+        }
+        return respond;
+    }
+
+    std::string_view messages = message.to_string_view();
+
+    // Logging
+    //if (messages != "N")
+    //    std::cout << "Get respond [" << messages << "]" << std::endl;
+
+    std::string respond(takeMessagePart(messages, kMessageDelimiter));
+    while (!messages.empty())
+        session.savedMessages.push(std::string(takeMessagePart(messages, kMessageDelimiter)));
+    return respond;
+}
+
+// Send request without waiting for respond. Returns request ID to get respond with
+uint32_t sendRequest(Session& session, const std::string& request) {
+    zmq::message_t message(request);
+    if (!session.isPipelined) {
+        session.socket.send(message, zmq::send_flags::none);
+        return 0;
+    }
+
+    // Request ID and empty delimiter are routing frames for server, like REQ socket adds delimiter
+    uint32_t requestID = ++session.lastRequestID;
+    zmq::message_t idFrame(&requestID, sizeof(requestID)), delimiter;
+    session.socket.send(idFrame, zmq::send_flags::sndmore);
+    session.socket.send(delimiter, zmq::send_flags::sndmore);
+    session.socket.send(message, zmq::send_flags::none);
+    return requestID;
+}
+
+// Wait for respond to request and split it into some messages. Responds to other requests
+// which come first are kept, their messages are saved in order they come
+std::string receiveRespond(Session& session, uint32_t requestID) {
+    zmq::message_t message;
+    if (!session.isPipelined) {
+        session.socket.recv(message, zmq::recv_flags::none);
+        return splitRespond(session, message);
+    }
+
+    while (true) {
+        auto ready = session.readyResponds.find(requestID);
+        if (ready != session.readyResponds.end()) {
+            std::string respond = std::move(ready->second);
+            session.readyResponds.erase(ready);
+            return respond;
+        }
+
+        // Respond: [request ID][empty][respond][saved messages...]
+        zmq::message_t idFrame, delimiter;
+        session.socket.recv(idFrame, zmq::recv_flags::none);
+        if (!idFrame.more())
+            continue;
+        session.socket.recv(delimiter, zmq::recv_flags::none);
+        if (!delimiter.more())
+            continue;
+        session.socket.recv(message, zmq::recv_flags::none);
+
+        uint32_t respondID = 0;
+        if (idFrame.size() == sizeof(respondID))
+            std::memcpy(&respondID, idFrame.data(), sizeof(respondID));
+        session.readyResponds[respondID] = splitRespond(session, message);
+    }
+}
+
+// Send request and split respond into some messages. Get direct respond for request.
+std::string getServerRespond(Session& session, const std::string& request) {
+    std::string respond = receiveRespond(session, sendRequest(session, request));
+    if (respond == std::string(1, kNothing))
+        return getSavedMessage(session);
+    return respond;
+}
+
+// Get next message without request. If there are saved messages, then returns them first.
+// With timeout server holds request until message arrives or timeout expires
+std::string getNextMessage(Session& session, int timeout) {
+    std::string respond = getSavedMessage(session);
+    if (respond.empty())
+        respond = getServerRespond(session, pollRequest(session, timeout));
+    return respond;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <zmq.hpp>
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Connection of one user to server. Used by client and load generator.
+// Strict session (REQ socket) waits for respond before next request. Pipelined session (DEALER socket)
+// has several requests in flight: every request goes with request ID frame, server returns routing frames
+// with respond as they are, so responds which come out of order are matched by ID.
+// Requests in flight are handled by server in parallel, so only independent requests should be pipelined
+typedef struct structSession {
+    zmq::socket_t socket; // Socket for messages
+    bool isPipelined;
+    bool useBinaryProtocol; // Use binary protocol instead of text one
+    std::string uniqueID; // Unique sequence for user
+    uint64_t uniqueNumber; // Unique sequence as number for binary protocol
+    std::string gameName; // Name of game room
+    int gameID; // ID of game room
+    std::queue<std::string> savedMessages; // Additional messages from server
+    uint32_t lastRequestID;
+    std::unordered_map<uint32_t, std::string> readyResponds; // Responds which came before they were asked
+    structSession(zmq::context_t& context, bool pipelined = false);
+} Session;
+
+// Build login request
+std::string loginRequest(const Session& session, const std::string& login);
+
+// Build create game request
+std::string createGameRequest(const Session& session, const std::string& gameName);
+
+// Build game list request. Limit 0 - whole list, otherwise page of games after cursor
+std::string gameListRequest(const Session& session, int cursor = 0, int limit = 0);
+
+// Build request of game list changes since version
+std::string gameListChangesRequest(const Session& session, uint64_t version);
+
+// Build join game request
+std::string joinGameRequest(const Session& session, const std::string& gameName);
+
+// Build request of game with bot
+std::string playBotRequest(const Session& session, const std::string& gameName);
+
+// Build invite request for session's game
+std::string inviteRequest(const Session& session, const std::string& login);
+
+// Build game field request. Returns empty string if field can't be packed for binary protocol
+std::string fieldRequest(const Session& session, const std::vector<std::string>& field);
+
+// Build move request
+std::string moveRequest(const Session& session, int row, int column);
+
+// Build poll request. With timeout server holds request until message arrives or timeout expires
+std::string pollRequest(const Session& session, int timeout);
+
+// Remember UID from login respond
+void setSessionUser(Session& session, const std::string& respond);
+
+// Gets game ID from create or join respond
+int getRespondGameID(const std::string& respond);
+
+// Get message from saved messages
+std::string getSavedMessage(Session& session);
+
+// Send request without waiting for respond. Returns request ID to get respond with
+uint32_t sendRequest(Session& session, const std::string& request);
+
+// Wait for respond to request and split it into some messages. Responds to other requests
+// which come first are kept, their messages are saved in order they come
+std::string receiveRespond(Session& session, uint32_t requestID);
+
+// Send request and split respond into some messages. Get direct respond for request.
+std::string getServerRespond(Session& session, const std::string& request);
+
+// Get next message without request. If there are saved messages, then returns them first.
+// With timeout server holds request until message arrives or timeout expires
+std::string getNextMessage(Session& session, int timeout = 0);
@@ -0,0 +1,339 @@
+#include <zmq.hpp>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+#include "ServerConnection.h"
+#include "ClientProtocol.h"
+#include "Rules.h"
+#include "Bot.h"
+
+// Headless bots which play games with each other to measure server throughput and latency.
+// Every thread drives its pairs of bots one game at a time, so concurrency is number of threads.
+// With --pipeline bots use pipelined sessions and send independent requests together.
+// Usage: LoadGenerator [--users N] [--concurrency C] [--games G] [--think ms] [--binary] [--pipeline] [--endpoint addr]
+
+typedef std::chrono::steady_clock Clock;
+
+const char kMeasuredTypes[] = { kLogin, kCreateGame, kGetGameList, kJoinGame, kInvitePlayer,
+    kFieldCheck, kDoAction, kNothing };
+const int kBotPollTimeout = 1000; // Poll timeout while bot waits for message, ms
+const int kMaxMessageWaits = 30; // Bot gives up game after this number of empty polls
+
+// Options of load
+typedef struct structLoadOptions {
+    int users = 100;
+    int concurrency = 10;
+    int gamesPerPair = 1;
+    int thinkTime = 0;
+    bool useBinaryProtocol = false;
+    bool isPipelined = false;
+    std::string endpoint = kServerPort;
+} LoadOptions;
+
+// Results of one thread. Latencies are in microseconds
+typedef struct structLoadStats {
+    std::map<char, std::vector<long long>> latencies;
+    long long requests = 0;
+    long long finishedGames = 0;
+    long long failedGames = 0;
+} LoadStats;
+
+// Synthetic user
+typedef struct structBot {
+    Session session;
+    std::string login;
+    std::vector<int> shots; // Order of cells to shoot at
+    int nextShot;
+    int hits;
+    structBot(zmq::context_t& context, bool isPipelined) : session(context, isPipelined), nextShot(0), hits(0) {}
+} Bot;
+
+// ===========================================================================================
+//
+//                                   Bot procedures
+//
+// ===========================================================================================
+
+// Send request and remember its latency
+std::string timedRespond(Bot& bot, LoadStats& stats, char type, const std::string& request) {
+    Clock::time_point start = Clock::now();
+    std::string respond = getServerRespond(bot.session, request);
+    long long latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+
+    stats.latencies[type].push_back(latency);
+    ++stats.requests;
+    return respond;
+}
+
+// Send requests together and wait for all responds. Latency of every request is counted from sending.
+// Strict session sends them one by one
+std::vector<std::string> timedResponds(Bot& bot, LoadStats& stats,
+    const std::vector<std::pair<char, std::string>>& requests) {
+    std::vector<std::string> responds;
+    if (!bot.session.isPipelined) {
+        for (auto& [type, request] : requests)
+            responds.push_back(timedRespond(bot, stats, type, request));
+        return responds;
+    }
+
+    Clock::time_point start = Clock::now();
+    std::vector<uint32_t> requestIDs;
+    for (auto& request : requests)
+        requestIDs.push_back(sendRequest(bot.session, request.second));
+
+    for (size_t i = 0; i < requests.size(); ++i) {
+        responds.push_back(receiveRespond(bot.session, requestIDs[i]));
+        long long latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+        stats.latencies[requests[i].first].push_back(latency);
+        ++stats.requests;
+    }
+    return responds;
+}
+
+// Wait for message of given type. Other messages are skipped
+bool waitForMessage(Bot& bot, LoadStats& stats, char type) {
+    for (int i = 0; i < kMaxMessageWaits; ++i) {
+        std::string message = getSavedMessage(bot.session);
+        if (message.empty())
+            message = timedRespond(bot, stats, kNothing, pollRequest(bot.session, kBotPollTimeout));
+
+        if (!message.empty() && message[0] == type)
+            return true;
+    }
+    return false;
+}
+
+// Field rows of fleet for field request: '@' - ship, '.' - sea
+std::vector<std::string> fleetField(const Board& fleet) {
+    std::vector<std::string> field(kFieldSize, std::string(kFieldSize, '.'));
+    for (int row = 0; row < kFieldSize; ++row)
+        for (int column = 0; column < kFieldSize; ++column)
+            if (fleet.test(row * kBoardStride + column))
+                field[row][column] = '@';
+    return field;
+}
+
+// Prepare bot for new game
+void resetBot(Bot& bot, std::mt19937& random) {
+    bot.shots.resize(kFieldSize * kFieldSize);
+    for (int i = 0; i < kFieldSize * kFieldSize; ++i)
+        bot.shots[i] = i;
+    std::shuffle(bot.shots.begin(), bot.shots.end(), random);
+    bot.nextShot = 0;
+    bot.hits = 0;
+}
+
+// Shoot until miss or end of game. Returns false if server failed request
+bool makeBotMove(Bot& bot, Bot& enemy, LoadStats& stats, const LoadOptions& options) {
+    while (bot.nextShot < kFieldSize * kFieldSize) {
+        if (options.thinkTime > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(options.thinkTime));
+
+        int cell = bot.shots[bot.nextShot++];
+        std::string respond = timedRespond(bot, stats, kDoAction,
+            moveRequest(bot.session, cell / kFieldSize, cell % kFieldSize));
+        if (respond.size() < 3 || respond[0] != kDoAction)
+            return false;
+
+        // Enemy is long polling while bot shoots
+        timedRespond(enemy, stats, kNothing, pollRequest(enemy.session, kBotPollTimeout));
+
+        int result = respond[2] - '0';
+        if (result == kDamagedShip || result == kDestroyed)
+            ++bot.hits;
+        else
+            return true;
+
+        if (bot.hits == kFleetCells)
+            return true;
+    }
+    return false;
+}
+
+// Play one game between two bots. Returns false if game was not finished
+bool playBotGame(Bot& host, Bot& guest, const std::string& gameName, LoadStats& stats,
+    const LoadOptions& options, std::mt19937& random) {
+    std::string respond = timedRespond(host, stats, kCreateGame, createGameRequest(host.session, gameName));
+    if (respond[0] != kCreateGame)
+        return false;
+    host.session.gameName = gameName;
+    host.session.gameID = getRespondGameID(respond);
+
+    timedRespond(host, stats, kInvitePlayer, inviteRequest(host.session, guest.login));
+    if (!waitForMessage(guest, stats, kInvitePlayer))
+        return false;
+
+    // Game list and join don't depend on each other
+    respond = timedResponds(guest, stats, { { kGetGameList, gameListRequest(guest.session) },
+        { kJoinGame, joinGameRequest(guest.session, gameName) } })[1];
+    if (respond[0] != kJoinGame)
+        return false;
+    guest.session.gameName = gameName;
+    guest.session.gameID = getRespondGameID(respond);
+
+    if (!waitForMessage(host, stats, kPlayerJoinYourGame))
+        return false;
+
+    Bot* bots[2] = { &host, &guest };
+    for (Bot* bot : bots) {
+        resetBot(*bot, random);
+
+        // Fleet is placed by the same rules as fleet of server bot and checked by server rules
+        Board fleet = randomFleet();
+        if (checkFleet(fleet) != 0)
+            return false;
+        respond = timedRespond(*bot, stats, kFieldCheck, fieldRequest(bot->session, fleetField(fleet)));
+        if (respond[0] != kFieldCheck)
+            return false;
+    }
+
+    // Host's start message tells who moves first
+    int mover = -1;
+    for (int i = 0; i < kMaxMessageWaits && mover == -1; ++i) {
+        std::string message = getSavedMessage(host.session);
+        if (message.empty())
+            message = timedRespond(host, stats, kNothing, pollRequest(host.session, kBotPollTimeout));
+        if (message.size() >= 3 && message[0] == kStartGame)
+            mover = message[2] == 'Y' ? 0 : 1;
+    }
+    if (mover == -1 || !waitForMessage(guest, stats, kStartGame))
+        return false;
+
+    while (true) {
+        if (!makeBotMove(*bots[mover], *bots[1 - mover], stats, options))
+            return false;
+        if (bots[mover]->hits == kFleetCells)
+            break;
+        mover = 1 - mover;
+    }
+
+    return waitForMessage(host, stats, kGameEnd) && waitForMessage(guest, stats, kGameEnd);
+}
+
+// Thread procedure. Logs in its bots and plays games between pairs
+void runBots(int threadNumber, int pairs, const LoadOptions& options, zmq::context_t& context, LoadStats& stats) {
+    std::mt19937 random(std::random_device{}() + threadNumber);
+    seedBot(random());
+    std::string prefix = "bot" + std::to_string(threadNumber) + "_" + std::to_string(random() % 1000000) + "_";
+
+    std::vector<std::unique_ptr<Bot>> bots;
+    for (int i = 0; i < pairs * 2; ++i) {
+        bots.push_back(std::make_unique<Bot>(context, options.isPipelined));
+        Bot& bot = *bots.back();
+        bot.session.useBinaryProtocol = options.useBinaryProtocol;
+        bot.session.socket.connect(options.endpoint);
+        bot.login = prefix + std::to_string(i);
+
+        std::string respond = timedRespond(bot, stats, kLogin, loginRequest(bot.session, bot.login));
+        if (respond[0] != kLogin) {
+            std::cout << "Login " << bot.login << " failed" << std::endl;
+            return;
+        }
+        setSessionUser(bot.session, respond);
+    }
+
+    for (int game = 0; game < options.gamesPerPair; ++game)
+        for (int pair = 0; pair < pairs; ++pair) {
+            std::string gameName = prefix + "game" + std::to_string(pair) + "_" + std::to_string(game);
+            if (playBotGame(*bots[pair * 2], *bots[pair * 2 + 1], gameName, stats, options, random))
+                ++stats.finishedGames;
+            else
+                ++stats.failedGames;
+        }
+}
+
+// ===========================================================================================
+//
+//                                       Report
+//
+// ===========================================================================================
+
+// Value of sorted latencies at given percentile
+long long percentile(const std::vector<long long>& latencies, double rank) {
+    size_t index = (size_t)(rank * (latencies.size() - 1) + 0.5);
+    return latencies[index];
+}
+
+// Print throughput and latency per message type
+void printReport(const LoadStats& total, double seconds) {
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Time: " << seconds << " s" << std::endl;
+    std::cout << "Requests: " << total.requests << " (" << total.requests / seconds << " req/s)" << std::endl;
+    std::cout << "Games: " << total.finishedGames << " finished, " << total.failedGames << " failed ("
+        << total.finishedGames / seconds << " games/s)" << std::endl << std::endl;
+
+    std::cout << "Type      Count   p50 us   p99 us  p999 us" << std::endl;
+    for (char type : kMeasuredTypes) {
+        auto latencies = total.latencies.find(type);
+        if (latencies == total.latencies.end() || latencies->second.empty())
+            continue;
+
+        std::cout << std::setw(4) << type << std::setw(11) << latencies->second.size()
+            << std::setw(9) << percentile(latencies->second, 0.5)
+            << std::setw(9) << percentile(latencies->second, 0.99)
+            << std::setw(9) << percentile(latencies->second, 0.999) << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    LoadOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--binary")
+            options.useBinaryProtocol = true;
+        else if (argument == "--pipeline")
+            options.isPipelined = true;
+        else if (i + 1 < argc && argument == "--users")
+            options.users = std::atoi(argv[++i]);
+        else if (i + 1 < argc && argument == "--concurrency")
+            options.concurrency = std::atoi(argv[++i]);
+        else if (i + 1 < argc && argument == "--games")
+            options.gamesPerPair = std::atoi(argv[++i]);
+        else if (i + 1 < argc && argument == "--think")
+            options.thinkTime = std::atoi(argv[++i]);
+        else if (i + 1 < argc && argument == "--endpoint")
+            options.endpoint = argv[++i];
+    }
+
+    int pairs = (std::max)(options.users / 2, 1);
+    int threads = (std::max)((std::min)(options.concurrency, pairs), 1);
+    std::cout << "Running " << pairs * 2 << " bots in " << threads << " threads, "
+        << options.gamesPerPair << " games per pair" << std::endl;
+
+    zmq::context_t context(1);
+    std::vector<LoadStats> stats(threads);
+    std::vector<std::thread> workers;
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < threads; ++i) {
+        int threadPairs = pairs / threads + (i < pairs % threads ? 1 : 0);
+        workers.emplace_back(runBots, i, threadPairs, std::cref(options), std::ref(context), std::ref(stats[i]));
+    }
+    for (std::thread& worker : workers)
+        worker.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    LoadStats total;
+    for (LoadStats& threadStats : stats) {
+        total.requests += threadStats.requests;
+        total.finishedGames += threadStats.finishedGames;
+        total.failedGames += threadStats.failedGames;
+        for (auto& latencies : threadStats.latencies) {
+            std::vector<long long>& merged = total.latencies[latencies.first];
+            merged.insert(merged.end(), latencies.second.begin(), latencies.second.end());
+        }
+    }
+    for (auto& latencies : total.latencies)
+        std::sort(latencies.second.begin(), latencies.second.end());
+
+    printReport(total, seconds);
+    return 0;
+}
@@ -0,0 +1,394 @@
+#include <zmq.hpp>
+#include <cstring>
+#include <string>
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+
+#include "ServerConnection.h"
+#include "BinaryProtocol.h"
+#include "Protocol.h"
+#include "MessageTokenizer.h"
+#include "Sharding.h"
+#include "Config.h"
+#include "Logger.h"
+
+// Router in front of server shards. Clients connect to it as to one server, every request is sent
+// to shard which owns its user or game (see Sharding.h). Router handles some requests itself:
+// - login: after login user is registered on other shards, so their games know his login;
+// - whole game list: lists of all shards are merged;
+// - game list page: after last page of shard goes first page of next shard.
+// Game list versions are kept by every shard, so changes request fails and client reloads list.
+// Usage: Router --shards N [options of Config.h]. Shards are started as Server --shard I --shards N
+
+typedef std::vector<zmq::message_t> Frames;
+
+const int kShardTimeout = 2000; // How long router waits for shards, ms
+const int kExpireCheckInterval = 100; // How often expired requests are checked, ms
+const unsigned char kTagMarker = 0xFF; // First byte of tag frame. Client identities given by router start with 0
+const int kTagFrameSize = 1 + sizeof(uint32_t);
+
+// Request handled by router. Shards get it with tag frame instead of client's routing frames
+typedef struct structPendingRequest {
+    Frames envelope;             // Routing frames of client
+    char type = kNothing;
+    bool isBinary = false;
+    bool isRegistering = false;  // User is logged in and is registered on other shards
+    bool isWholeList = false;    // Game list is asked from all shards
+    int shard = 0;               // Shard of game list page
+    int remainingReplies = 0;
+    uint64_t deadline = 0;
+    std::string login;
+    Frames reply;                // Login reply kept while user is registered
+    std::vector<Frames> replies; // Game lists of shards
+} PendingRequest;
+
+std::unordered_map<uint32_t, PendingRequest> pendingRequests;
+uint32_t lastTag = 0;
+
+// Current time for deadlines, ms
+uint64_t tickCount() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ===========================================================================================
+//
+//                                   Frames
+//
+// ===========================================================================================
+
+// Receive all frames of message
+void receiveFrames(zmq::socket_t& socket, Frames& frames) {
+    frames.clear();
+    do {
+        frames.emplace_back();
+        if (!socket.recv(frames.back(), zmq::recv_flags::none)) {
+            frames.clear();
+            return;
+        }
+    } while (frames.back().more());
+}
+
+// Send routing frames of client and reply frames
+void replyToClient(zmq::socket_t& clients, Frames& envelope, Frames& reply) {
+    for (zmq::message_t& frame : envelope)
+        clients.send(frame, zmq::send_flags::sndmore);
+    for (size_t i = 0; i < reply.size(); ++i)
+        clients.send(reply[i], i + 1 < reply.size() ? zmq::send_flags::sndmore : zmq::send_flags::none);
+}
+
+// Send fail respond to client
+void replyFailure(zmq::socket_t& clients, Frames& envelope, bool isBinary) {
+    Frames reply;
+    reply.emplace_back(encodeRespond(Respond(kFailure), isBinary));
+    replyToClient(clients, envelope, reply);
+}
+
+// Send request to shard. Shard which is down doesn't block router. Returns false if request is not sent
+bool sendToShard(zmq::socket_t& shard, Frames& envelope, const zmq::message_t& body) {
+    if (!shard.send(envelope[0], zmq::send_flags::sndmore | zmq::send_flags::dontwait))
+        return false;
+
+    zmq::message_t request(body.data(), body.size());
+    for (size_t i = 1; i < envelope.size(); ++i)
+        shard.send(envelope[i], zmq::send_flags::sndmore);
+    shard.send(request, zmq::send_flags::none);
+    return true;
+}
+
+// Send request handled by router to shard
+bool sendTagged(zmq::socket_t& shard, uint32_t tag, const zmq::message_t& body) {
+    Frames envelope(2);
+    envelope[0] = zmq::message_t(kTagFrameSize);
+    static_cast<unsigned char*>(envelope[0].data())[0] = kTagMarker;
+    std::memcpy(static_cast<unsigned char*>(envelope[0].data()) + 1, &tag, sizeof(tag));
+    return sendToShard(shard, envelope, body);
+}
+
+// Check if frame is tag of request handled by router
+bool isTagFrame(const zmq::message_t& frame, uint32_t& tag) {
+    if (frame.size() != kTagFrameSize || *static_cast<const unsigned char*>(frame.data()) != kTagMarker)
+        return false;
+    std::memcpy(&tag, static_cast<const unsigned char*>(frame.data()) + 1, sizeof(tag));
+    return true;
+}
+
+// Gets type of shard respond
+char respondType(const zmq::message_t& body) {
+    if (isBinaryFrame(body.data(), body.size()))
+        return readBinaryHeader(body.data()).type;
+    return body.size() == 0 ? kFailure : *static_cast<const char*>(body.data());
+}
+
+// ===========================================================================================
+//
+//                                   Requests routing
+//
+// ===========================================================================================
+
+// Gets shard which owns user or game of request
+int requestShard(const Request& request) {
+    switch (request.type) {
+    case kLogin:
+        return shardOfName(request.login);
+    case kCreateGame:
+    case kJoinGame:
+    case kPlayBot:
+    case kInvitePlayer:
+    case kFieldCheck:
+    case kDoAction:
+        return request.gameID != 0 ? shardOfGame(request.gameID) : shardOfName(request.gameName);
+    case kGetGameList:
+        // Cursor is ID of game of shard or number of shard to start from
+        return shardOfGame(request.cursor);
+    default:
+        return shardOfUser(request.uniqueID);
+    }
+}
+
+// Sends client request to its shard or starts request handled by router
+void handleClientRequest(zmq::socket_t& clients, std::vector<zmq::socket_t>& shards) {
+    Frames frames;
+    receiveFrames(clients, frames);
+    if (frames.size() < 2)
+        return;
+
+    zmq::message_t body = std::move(frames.back());
+    frames.pop_back();
+    Request request;
+    bool isCorrect = decodeRequest(body, request);
+
+    // Requests between router and shards are not accepted from clients
+    bool isInternal = request.type == kRegisterUser || request.type == kDeliverMessage || request.type == kExpireUser;
+    if (!isCorrect || isInternal || (request.type == kGameListChanges && shardCount > 1)) {
+        replyFailure(clients, frames, request.isBinary);
+        return;
+    }
+
+    bool isHandled = (request.type == kLogin || request.type == kGetGameList) && shardCount > 1;
+    if (!isHandled) {
+        if (!sendToShard(shards[requestShard(request)], frames, body))
+            replyFailure(clients, frames, request.isBinary);
+        return;
+    }
+
+    uint32_t tag = ++lastTag;
+    PendingRequest& pending = pendingRequests[tag];
+    pending.envelope = std::move(frames);
+    pending.type = request.type;
+    pending.isBinary = request.isBinary;
+    pending.deadline = tickCount() + kShardTimeout;
+    pending.login = request.login;
+    pending.isWholeList = request.type == kGetGameList && request.limit == 0;
+    pending.shard = requestShard(request);
+
+    if (!pending.isWholeList) {
+        pending.remainingReplies = 1;
+        sendTagged(shards[pending.shard], tag, body);
+        return;
+    }
+
+    for (zmq::socket_t& shard : shards)
+        if (sendTagged(shard, tag, body))
+            ++pending.remainingReplies;
+}
+
+// Registers logged in user on other shards. Client gets login reply when all shards know user
+void registerUser(std::vector<zmq::socket_t>& shards, uint32_t tag, PendingRequest& pending) {
+    const zmq::message_t& body = pending.reply[0];
+    uint64_t uniqueID;
+    if (pending.isBinary)
+        uniqueID = readBinaryHeader(body.data()).uniqueID;
+    else {
+        std::string_view respond = body.to_string_view();
+        takeMessagePart(respond, kMessagePartsDelimiter);
+        uniqueID = parseNumber(takeMessagePart(respond, kMessageDelimiter));
+    }
+
+    std::string request = std::string(1, kRegisterUser) + std::string(1, kMessagePartsDelimiter)
+        + std::to_string(uniqueID) + std::string(1, kMessagePartsDelimiter) + pending.login;
+    zmq::message_t registerRequest(request);
+
+    pending.isRegistering = true;
+    pending.remainingReplies = 0;
+    pending.deadline = tickCount() + kShardTimeout;
+    for (int shard = 0; shard < shardCount; ++shard)
+        if (shard != shardOfUser(uniqueID) && sendTagged(shards[shard], tag, registerRequest))
+            ++pending.remainingReplies;
+}
+
+// Continues game list page: after last page of shard goes first page of next shard
+void continueGameListPage(zmq::message_t& body, bool isBinary, int shard) {
+    if (respondType(body) != kGetGameList || shard + 1 >= shardCount)
+        return;
+
+    // Page starts with #Version#NextCursor
+    std::string page(body.to_string_view());
+    size_t cursorStart = page.find(kMessagePartsDelimiter, (isBinary ? kBinaryHeaderSize : 1) + 1);
+    if (cursorStart == std::string::npos)
+        return;
+    ++cursorStart;
+    size_t cursorEnd = page.find_first_of(std::string(1, kMessagePartsDelimiter) + kMessageDelimiter, cursorStart);
+    if (cursorEnd == std::string::npos)
+        cursorEnd = page.size();
+    if (parseNumber(std::string_view(page).substr(cursorStart, cursorEnd - cursorStart)) != 0)
+        return;
+
+    page.replace(cursorStart, cursorEnd - cursorStart, std::to_string(shard + 1));
+    body = zmq::message_t(page);
+}
+
+// Sends game lists of all shards as one list
+void replyGameList(zmq::socket_t& clients, PendingRequest& pending) {
+    std::string gameList, messages;
+    Frames reply(1);
+    for (Frames& shardReply : pending.replies) {
+        if (respondType(shardReply[0]) != kGetGameList)
+            continue;
+
+        std::string_view list = shardReply[0].to_string_view();
+        list.remove_prefix(pending.isBinary ? kBinaryHeaderSize : 1);
+
+        // Saved messages of user come from his shard
+        if (pending.isBinary) {
+            for (size_t i = 1; i < shardReply.size(); ++i)
+                reply.push_back(std::move(shardReply[i]));
+        }
+        else if (list.find(kMessageDelimiter) != std::string_view::npos) {
+            size_t position = list.find(kMessageDelimiter);
+            messages += (messages.empty() ? "" : std::string(1, kMessageDelimiter)) + std::string(list.substr(position + 1));
+            list = list.substr(0, position);
+        }
+
+        // Skip #Version#NextCursor
+        takeMessagePart(list, kMessagePartsDelimiter);
+        takeMessagePart(list, kMessagePartsDelimiter);
+        takeMessagePart(list, kMessagePartsDelimiter);
+        if (!list.empty())
+            gameList += std::string(1, kMessagePartsDelimiter) + std::string(list);
+    }
+
+    Respond respond(kGetGameList);
+    respond.payload = std::string(1, kMessagePartsDelimiter) + "0" + std::string(1, kMessagePartsDelimiter) + "0" + gameList;
+    std::string message = encodeRespond(respond, pending.isBinary);
+    if (!messages.empty())
+        message += std::string(1, kMessageDelimiter) + messages;
+    reply[0] = zmq::message_t(message);
+    replyToClient(clients, pending.envelope, reply);
+}
+
+// Sends shard respond to client or continues request handled by router
+void handleShardReply(zmq::socket_t& clients, std::vector<zmq::socket_t>& shards, zmq::socket_t& shard) {
+    Frames frames;
+    receiveFrames(shard, frames);
+    if (frames.empty())
+        return;
+
+    uint32_t tag;
+    if (!isTagFrame(frames[0], tag)) {
+        // Routing frames of client come back with respond
+        for (size_t i = 0; i < frames.size(); ++i)
+            clients.send(frames[i], i + 1 < frames.size() ? zmq::send_flags::sndmore : zmq::send_flags::none);
+        return;
+    }
+
+    // Request could be expired already
+    auto request = pendingRequests.find(tag);
+    if (request == pendingRequests.end() || frames.size() < 3)
+        return;
+
+    PendingRequest& pending = request->second;
+    frames.erase(frames.begin(), frames.begin() + 2);
+    --pending.remainingReplies;
+
+    if (pending.type == kLogin && !pending.isRegistering) {
+        pending.reply = std::move(frames);
+        if (respondType(pending.reply[0]) == kLogin)
+            registerUser(shards, tag, pending);
+    }
+    else if (pending.type == kGetGameList && pending.isWholeList)
+        pending.replies.push_back(std::move(frames));
+    else if (pending.type == kGetGameList) {
+        continueGameListPage(frames[0], pending.isBinary, pending.shard);
+        pending.reply = std::move(frames);
+    }
+
+    if (pending.remainingReplies > 0)
+        return;
+
+    if (pending.isWholeList)
+        replyGameList(clients, pending);
+    else
+        replyToClient(clients, pending.envelope, pending.reply);
+    pendingRequests.erase(request);
+}
+
+// Answers requests which waited for shards too long with what router has
+void expirePendingRequests(zmq::socket_t& clients) {
+    uint64_t now = tickCount();
+    for (auto request = pendingRequests.begin(); request != pendingRequests.end();) {
+        PendingRequest& pending = request->second;
+        if (pending.deadline > now) {
+            ++request;
+            continue;
+        }
+
+        logWarning("Request [", pending.type, "] waited too long for ", pending.remainingReplies, " shards");
+        if (pending.isWholeList)
+            replyGameList(clients, pending);
+        else if (pending.isRegistering)
+            replyToClient(clients, pending.envelope, pending.reply);
+        else
+            replyFailure(clients, pending.envelope, pending.isBinary);
+        request = pendingRequests.erase(request);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::cout << "===========================================" << std::endl;
+    std::cout << "                  ROUTER LOG               " << std::endl;
+    std::cout << "===========================================" << std::endl;
+
+    ServerConfig config;
+    if (!readConfig(argc, argv, config, true))
+        return 1;
+    printConfig(config, true);
+    shardCount = config.shardCount;
+    logLevel = config.logLevel;
+    if (!startLogger(config.logFile))
+        std::cout << "Unable to open log " << config.logFile << ", log is written to stdout" << std::endl;
+
+    zmq::context_t context(config.ioThreads);
+    zmq::socket_t clients(context, ZMQ_ROUTER);
+    clients.set(zmq::sockopt::sndhwm, config.highWaterMark);
+    clients.set(zmq::sockopt::rcvhwm, config.highWaterMark);
+    clients.bind(config.clientPort);
+
+    std::vector<zmq::socket_t> shards;
+    std::vector<zmq::pollitem_t> items = { { clients.handle(), 0, ZMQ_POLLIN, 0 } };
+    for (int shard = 0; shard < shardCount; ++shard) {
+        shards.emplace_back(context, ZMQ_DEALER);
+        shards.back().set(zmq::sockopt::sndhwm, config.highWaterMark);
+        shards.back().set(zmq::sockopt::rcvhwm, config.highWaterMark);
+        shards.back().connect(config.shardEndpoints[shard]);
+    }
+    for (zmq::socket_t& shard : shards)
+        items.push_back({ shard.handle(), 0, ZMQ_POLLIN, 0 });
+
+    while (true) {
+        zmq::poll(items.data(), items.size(), std::chrono::milliseconds(kExpireCheckInterval));
+
+        if (items[0].revents & ZMQ_POLLIN)
+            handleClientRequest(clients, shards);
+        for (int shard = 0; shard < shardCount; ++shard)
+            if (items[1 + shard].revents & ZMQ_POLLIN)
+                handleShardReply(clients, shards, shards[shard]);
+
+        expirePendingRequests(clients);
+    }
+
+    flushLogger();
+    return 0;
+}
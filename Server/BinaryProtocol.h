@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// Binary protocol. Client chooses it by sending binary requests, server responds in the same protocol.
+// Every frame starts with fixed-size header, then goes payload:
+// [L] login                          -> [L] header.uniqueID
+// [C] game name                      -> [C] header.gameID
+// [G] - or cursor, limit (kGameListPageSize) -> [G] #Version#NextCursor#Game1#Game2...
+// [V] version (kGameListVersionSize) -> [V] #NewVersion#+OpenedGame#-ClosedGame...
+// [J] game name (if gameID is 0)     -> [J] header.gameID
+// [B] game name                      -> [B] header.gameID
+// [I] login                          -> [I]
+// [M] packed field (kFieldBitmapSize) -> [M]
+// [D] row, column (kMoveSize)         -> [D] header.result
+// [N] timeout (optional, kPollTimeoutSize) -> [N]
+// Saved messages are sent as next frames of multipart respond in text format.
+// Numbers are sent in little-endian byte order.
+
+// First byte of binary frame. Text messages always start with letter
+const unsigned char kBinaryMagic = 0xB5;
+
+#pragma pack(push, 1)
+typedef struct structBinaryHeader {
+    uint8_t magic;
+    char type;       // Type of message, same as in text protocol
+    uint8_t result;  // Result of move
+    uint8_t reserved;
+    uint32_t gameID;
+    uint64_t uniqueID;
+} BinaryHeader;
+#pragma pack(pop)
+
+const int kBinaryHeaderSize = sizeof(BinaryHeader);
+const int kMoveSize = 2;
+const int kFieldBitmapSize = 13; // 100 cells, one bit per cell
+const int kPollTimeoutSize = 4;
+const int kGameListPageSize = 8; // Two uint32: cursor and limit
+const int kGameListVersionSize = 8;
+
+// Check if frame is binary
+inline bool isBinaryFrame(const void* data, size_t size) {
+    return size >= kBinaryHeaderSize && *static_cast<const unsigned char*>(data) == kBinaryMagic;
+}
+
+// Fill header of binary frame
+inline void fillBinaryHeader(void* frame, char type, uint64_t uniqueID, uint32_t gameID, uint8_t result = 0) {
+    BinaryHeader header = { kBinaryMagic, type, result, 0, gameID, uniqueID };
+    std::memcpy(frame, &header, kBinaryHeaderSize);
+}
+
+// Read header of binary frame
+inline BinaryHeader readBinaryHeader(const void* frame) {
+    BinaryHeader header;
+    std::memcpy(&header, frame, kBinaryHeaderSize);
+    return header;
+}
+
+// Mark ship cell in packed field
+inline void setFieldBit(uint8_t* bitmap, int row, int column) {
+    int cell = row * 10 + column;
+    bitmap[cell / 8] |= 1 << (cell % 8);
+}
+
+// Check if cell of packed field is ship
+inline bool getFieldBit(const uint8_t* bitmap, int row, int column) {
+    int cell = row * 10 + column;
+    return (bitmap[cell / 8] >> (cell % 8)) & 1;
+}
@@ -0,0 +1,174 @@
+#include <random>
+
+#include "Bot.h"
+
+// Every worker has own generator, so bots of different games don't wait for each other
+thread_local std::mt19937_64 botRandom(std::random_device{}());
+
+const int kDensityBits = 8; // Bits of placement counter of cell. Count never exceeds 3 * 36
+
+// Moves every cell of board by offset, cells moved out of board are dropped.
+// Empty column between rows keeps moves by one column from wrapping
+Board shiftBoard(const Board& board, int offset) {
+    return offset >= 0 ? board << offset : board >> -offset;
+}
+
+// Gets start cells of all ship placements of size which lie on allowed cells. Step is 1 for horizontal ship
+// and kBoardStride for vertical one
+Board placementStarts(const Board& allowed, int size, int step) {
+    Board starts = allowed;
+    for (int i = 1; i < size; ++i)
+        starts &= shiftBoard(allowed, -i * step);
+    return starts;
+}
+
+// Gets start cells of placements which touch cells of board by side or corner without covering them
+Board touchingStarts(const Board& cells, int size, int step) {
+    int side = step == 1 ? kBoardStride : 1;
+    Board starts = shiftBoard(cells, step) | shiftBoard(cells, -size * step);
+    for (int i = -1; i <= size; ++i)
+        starts |= shiftBoard(cells, -i * step - side) | shiftBoard(cells, -i * step + side);
+    return starts;
+}
+
+// Adds one to counters of cells. Counters are bit slices: slice i keeps bit i of every cell counter
+void addToCounters(Board counters[kDensityBits], Board cells) {
+    for (int i = 0; i < kDensityBits && cells.any(); ++i) {
+        Board carry = counters[i] & cells;
+        counters[i] ^= cells;
+        cells = carry;
+    }
+}
+
+// Adds placements to counters of cells covered by them
+void addPlacements(Board counters[kDensityBits], const Board& starts, int size, int step, int times) {
+    for (int time = 0; time < times; ++time)
+        for (int i = 0; i < size; ++i)
+            addToCounters(counters, shiftBoard(starts, i * step));
+}
+
+// Gets cells diagonal to cells of board
+Board diagonalCells(const Board& board) {
+    Board result = shiftBoard(board, kBoardStride + 1) | shiftBoard(board, kBoardStride - 1)
+        | shiftBoard(board, -kBoardStride + 1) | shiftBoard(board, -kBoardStride - 1);
+    return result & boardCells();
+}
+
+// Gets random cell of board. Board must have cells
+int randomCell(const Board& cells) {
+    size_t skip = botRandom() % cells.count();
+    for (int cell = 0; cell < kBoardBits; ++cell)
+        if (cells.test(cell) && skip-- == 0)
+            return cell;
+    return -1;
+}
+
+// Seeds generator of bots of this thread, so games can be repeated
+void seedBot(uint64_t seed) {
+    botRandom.seed(seed);
+}
+
+// Gets random number from generator of bots of this thread
+uint64_t botRandomNumber() {
+    return botRandom();
+}
+
+// Places fleet of random straight ships which don't touch each other. Ships are put on preferred cells while they fit
+Board randomFleet(const Board& preferred) {
+    while (true) {
+        Board fleet, free = boardCells();
+        bool isPlaced = true;
+        for (int size = kMaxShipSize; size >= 1 && isPlaced; --size)
+            for (int ship = 0; ship < kFleetShips[size] && isPlaced; ++ship) {
+                int step = botRandom() % 2 == 0 ? 1 : kBoardStride;
+                Board starts = placementStarts(free & preferred, size, step);
+                if (starts.none()) {
+                    step = step == 1 ? kBoardStride : 1;
+                    starts = placementStarts(free & preferred, size, step);
+                }
+                if (starts.none())
+                    starts = placementStarts(free, size, step);
+
+                // Ships placed before can leave no room, then fleet is placed again
+                isPlaced = starts.any();
+                if (!isPlaced)
+                    break;
+
+                Board shipBoard;
+                int start = randomCell(starts);
+                for (int i = 0; i < size; ++i)
+                    shipBoard.set(start + i * step);
+                fleet |= shipBoard;
+                free &= ~neighbourCells(shipBoard);
+            }
+
+        if (isPlaced)
+            return fleet;
+    }
+}
+
+// Chooses cell for shot at field with hits, misses and sunk ships. Returns row * kFieldSize + column
+int chooseBotShot(const Board& hits, const Board& misses, const Board& sunk) {
+    // Ships left afloat
+    int shipsLeft[kMaxShipSize + 1];
+    for (int size = 0; size <= kMaxShipSize; ++size)
+        shipsLeft[size] = kFleetShips[size];
+    Board sunkLeft = sunk;
+    for (int cell = 0; cell < kBoardBits && sunkLeft.any(); ++cell) {
+        if (!sunkLeft.test(cell))
+            continue;
+        Board ship = shipCells(sunkLeft, cell / kBoardStride, cell % kBoardStride);
+        sunkLeft &= ~ship;
+        if (ship.count() <= kMaxShipSize && shipsLeft[ship.count()] > 0)
+            --shipsLeft[ship.count()];
+    }
+
+    // Ships don't touch, so cells around sunk ships and corners of damaged ones are sea
+    Board wounded = hits & ~sunk;
+    Board sea = misses | neighbourCells(sunk) | diagonalCells(wounded);
+    Board allowed = boardCells() & ~sea;
+
+    // While ship is damaged, only placements through its cells are counted.
+    // Placements through two damaged cells go along the ship, they are counted three times
+    Board counters[kDensityBits];
+    bool isTargeting = wounded.any();
+    for (int size = 1; size <= kMaxShipSize; ++size) {
+        if (shipsLeft[size] == 0)
+            continue;
+
+        for (int step : { 1, kBoardStride }) {
+            // Ship of one cell is the same in both directions
+            if (size == 1 && step != 1)
+                break;
+
+            Board starts = placementStarts(allowed, size, step) & ~touchingStarts(wounded, size, step);
+            if (!isTargeting) {
+                addPlacements(counters, starts, size, step, shipsLeft[size]);
+                continue;
+            }
+
+            Board throughOne, throughTwo;
+            for (int i = 0; i < size; ++i) {
+                Board covered = shiftBoard(wounded, -i * step);
+                throughTwo |= throughOne & covered;
+                throughOne |= covered;
+            }
+            addPlacements(counters, starts & throughOne, size, step, shipsLeft[size]);
+            addPlacements(counters, starts & throughTwo, size, step, 2 * shipsLeft[size]);
+        }
+    }
+
+    // Cells with max counter are taken bit by bit from the highest slice
+    Board unknown = boardCells() & ~hits & ~misses;
+    Board candidates = unknown & ~sea;
+    if (candidates.none())
+        candidates = unknown;
+    for (int i = kDensityBits - 1; i >= 0; --i) {
+        Board higher = candidates & counters[i];
+        if (higher.any())
+            candidates = higher;
+    }
+
+    int cell = randomCell(candidates);
+    return cell / kBoardStride * kFieldSize + cell % kBoardStride;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+#include "Rules.h"
+
+// Built-in opponent of single player games. Bot is second player of game and has no state of its own:
+// shot is chosen from what human player would see on bot's screen (hits, misses and sunk ships),
+// so games restored after restart go on. Shot is aimed by probability density of all ship placements
+// which agree with the field. Placements are counted for all cells at once with bitboard shifts,
+// and counters are kept as bit slices, so one move takes several hundred word operations.
+const uint64_t kBotUID = 1; // UIDs of users always have generation bits, so they are never so small
+const char kBotLogin[] = "Bot";
+
+// Places fleet of random straight ships which don't touch each other. Ships are put on preferred cells while they fit
+Board randomFleet(const Board& preferred = boardCells());
+
+// Chooses cell for shot at field with hits, misses and sunk ships. Returns row * kFieldSize + column
+int chooseBotShot(const Board& hits, const Board& misses, const Board& sunk);
+
+// Seeds generator of bots of this thread, so games can be repeated
+void seedBot(uint64_t seed);
+
+// Gets random number from generator of bots of this thread
+uint64_t botRandomNumber();
+
+// Gets random cell of board. Board must have cells
+int randomCell(const Board& cells);
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "Config.h"
+#include "ServerConnection.h"
+#include "Sharding.h"
+#include "Logger.h"
+
+structServerConfig::structServerConfig() {
+    workerThreads = 0;
+    ioThreads = 1;
+    workersPort = kWorkersPort;
+    highWaterMark = kDefaultHighWaterMark;
+    pinWorkers = false;
+    firstCore = 0;
+    shardNumber = 0;
+    shardCount = 1;
+    logLevel = kLogInfo;
+    sessionTimeout = kDefaultSessionTimeout;
+    gameTimeout = kDefaultGameTimeout;
+}
+
+// Removes spaces around text
+std::string trimSpaces(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+        return "";
+    return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+// Parse number of option. Returns false if value is not a number
+bool parseOption(const std::string& value, int& number) {
+    auto parsed = std::from_chars(value.data(), value.data() + value.size(), number);
+    return parsed.ec == std::errc() && parsed.ptr == value.data() + value.size();
+}
+
+// Sets option. Returns false if option is unknown or value is wrong
+bool setOption(ServerConfig& config, const std::string& name, const std::string& value) {
+    if (name == "config")
+        config.configFile = value;
+    else if (name == "workers")
+        return parseOption(value, config.workerThreads);
+    else if (name == "io-threads")
+        return parseOption(value, config.ioThreads);
+    else if (name == "bind")
+        config.clientPort = value;
+    else if (name == "admin")
+        config.adminPort = value;
+    else if (name == "workers-endpoint")
+        config.workersPort = value;
+    else if (name == "hwm")
+        return parseOption(value, config.highWaterMark);
+    else if (name == "pin")
+        config.pinWorkers = value == "1" || value == "true" || value == "yes";
+    else if (name == "first-core")
+        return parseOption(value, config.firstCore);
+    else if (name == "shard")
+        return parseOption(value, config.shardNumber);
+    else if (name == "shards")
+        return parseOption(value, config.shardCount);
+    else if (name == "log-level")
+        return (config.logLevel = logLevelByName(value)) != -1;
+    else if (name == "log-file")
+        config.logFile = value;
+    else if (name == "session-timeout")
+        return parseOption(value, config.sessionTimeout);
+    else if (name == "game-timeout")
+        return parseOption(value, config.gameTimeout);
+    else if (name == "shard-endpoints") {
+        config.shardEndpoints.clear();
+        size_t start = 0;
+        while (start <= value.size()) {
+            size_t end = (std::min)(value.find(',', start), value.size());
+            config.shardEndpoints.push_back(trimSpaces(value.substr(start, end - start)));
+            start = end + 1;
+        }
+    }
+    else
+        return false;
+    return true;
+}
+
+// Reads options from config file
+bool readConfigFile(const std::string& fileName, ServerConfig& config) {
+    std::ifstream file(fileName);
+    if (!file) {
+        std::cout << "Unable to read config " << fileName << std::endl;
+        return false;
+    }
+
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+        line = line.substr(0, line.find('#'));
+        size_t equal = line.find('=');
+        std::string name = trimSpaces(line.substr(0, equal));
+        if (name.empty())
+            continue;
+
+        std::string value = equal == std::string::npos ? "1" : trimSpaces(line.substr(equal + 1));
+        if (!setOption(config, name, value)) {
+            std::cout << "Wrong option {" << name << "} in line " << lineNumber << " of " << fileName << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads configuration from file and command line and fills defaults. Returns false if option is wrong.
+// Router takes clients on client port even when there are shards
+bool readConfig(int argc, char* argv[], ServerConfig& config, bool isRouter) {
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::string(argv[i]) == "--config")
+            config.configFile = argv[i + 1];
+    if (!config.configFile.empty() && !readConfigFile(config.configFile, config))
+        return false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        std::string name = argument.size() > 2 && argument.compare(0, 2, "--") == 0 ? argument.substr(2) : "";
+        std::string value = "1";
+        if (name != "pin" && i + 1 < argc)
+            value = argv[++i];
+        else if (name != "pin")
+            name.clear();
+
+        if (name.empty() || !setOption(config, name, value)) {
+            std::cout << "Wrong option {" << argument << "}. Options are described in Config.h" << std::endl;
+            return false;
+        }
+    }
+
+    if (config.shardCount < 1 || config.shardCount > kMaxShards) {
+        std::cout << "Shard count should be 1.." << kMaxShards << std::endl;
+        return false;
+    }
+    if (config.shardNumber < 0 || config.shardNumber >= config.shardCount) {
+        std::cout << "Shard number should be less than shard count" << std::endl;
+        return false;
+    }
+    if (config.ioThreads < 1 || config.highWaterMark < 0 || config.firstCore < 0) {
+        std::cout << "I/O threads should be positive, high-water mark and first core can't be negative" << std::endl;
+        return false;
+    }
+    if (config.sessionTimeout < 0 || config.gameTimeout < 0) {
+        std::cout << "Timeouts can't be negative" << std::endl;
+        return false;
+    }
+
+    // Defaults which depend on other options
+    if (config.workerThreads <= 0)
+        config.workerThreads = (std::max)(1, (int)std::thread::hardware_concurrency());
+
+    bool isShard = config.shardCount > 1 && !isRouter;
+    if (config.clientPort.empty())
+        config.clientPort = isShard ? shardClientPort(config.shardNumber) : kClientPort;
+    if (config.adminPort.empty())
+        config.adminPort = isShard ? shardAdminPort(config.shardNumber) : kAdminPort;
+
+    if (config.shardEndpoints.empty())
+        for (int shard = 0; shard < config.shardCount; ++shard)
+            config.shardEndpoints.push_back(shardServerPort(shard));
+    if ((int)config.shardEndpoints.size() != config.shardCount) {
+        std::cout << "Shard endpoints should be given for all " << config.shardCount << " shards" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Prints effective configuration
+void printConfig(const ServerConfig& config, bool isRouter) {
+    std::cout << "Configuration" << (config.configFile.empty() ? "" : " from " + config.configFile) << ":" << std::endl;
+    if (!isRouter) {
+        std::cout << "  workers          " << config.workerThreads << " of " << std::thread::hardware_concurrency()
+            << " cores";
+        if (config.pinWorkers)
+            std::cout << ", pinned from core " << config.firstCore;
+        std::cout << std::endl;
+    }
+    std::cout << "  io-threads       " << config.ioThreads << std::endl;
+    std::cout << "  bind             " << config.clientPort << std::endl;
+    if (!isRouter) {
+        std::cout << "  admin            " << config.adminPort << std::endl;
+        std::cout << "  workers-endpoint " << config.workersPort << std::endl;
+        std::cout << "  session-timeout  " << config.sessionTimeout << " s" << std::endl;
+        std::cout << "  game-timeout     " << config.gameTimeout << " s" << std::endl;
+    }
+    std::cout << "  hwm              " << config.highWaterMark << std::endl;
+    std::cout << "  log              " << kLogLevelNames[config.logLevel] << " to "
+        << (config.logFile.empty() ? "stdout" : config.logFile) << std::endl;
+    if (config.shardCount == 1 && !isRouter)
+        return;
+
+    std::cout << "  shards           " << config.shardCount;
+    if (!isRouter)
+        std::cout << ", this is shard " << config.shardNumber;
+    std::cout << std::endl;
+    for (int shard = 0; shard < config.shardCount; ++shard)
+        std::cout << "    " << shard << ": " << config.shardEndpoints[shard] << std::endl;
+}
+
+// Pins current thread to core. Returns false if it is not supported or core is wrong
+bool pinThread(int core) {
+#ifdef _WIN32
+    if (core >= 64)
+        return false;
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core) != 0;
+#elif defined(__linux__)
+    cpu_set_t cores;
+    CPU_ZERO(&cores);
+    CPU_SET(core, &cores);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores) == 0;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Runtime configuration of server and router. File given by --config is read first, then command line,
+// so command line overrides file. File has one "option = value" per line, # starts comment.
+//   --workers N                  worker threads, 0 - one per core
+//   --io-threads N               ZMQ I/O threads
+//   --bind ENDPOINT              endpoint for clients
+//   --admin ENDPOINT             endpoint for admin requests
+//   --workers-endpoint ENDPOINT  endpoint between proxy and workers
+//   --hwm N                      high-water mark of client and worker sockets, messages
+//   --pin                        pin workers to cores, one core per worker
+//   --first-core N               core of first pinned worker
+//   --shard N                    number of this shard
+//   --shards N                   shard count
+//   --shard-endpoints E1,E2...   endpoints of all shards, by default shards are on localhost
+//   --log-level LEVEL            debug (every message), info, warning or error
+//   --log-file FILE              log file, by default log is written to stdout
+//   --session-timeout S          user without requests for S seconds is removed, 0 - never
+//   --game-timeout S             game without moves for S seconds is ended, 0 - never
+const char kWorkersPort[] = "inproc://workers"; // Default endpoint for workers
+const int kDefaultHighWaterMark = 1000; // Default of ZMQ
+const int kDefaultSessionTimeout = 600; // s
+const int kDefaultGameTimeout = 900; // s
+
+typedef struct structServerConfig {
+    std::string configFile;
+    int workerThreads;
+    int ioThreads;
+    std::string clientPort, adminPort, workersPort;
+    int highWaterMark;
+    bool pinWorkers;
+    int firstCore;
+    int shardNumber, shardCount;
+    std::vector<std::string> shardEndpoints;
+    int logLevel;
+    std::string logFile;
+    int sessionTimeout, gameTimeout;
+    structServerConfig();
+} ServerConfig;
+
+// Reads configuration from file and command line and fills defaults. Returns false if option is wrong.
+// Router takes clients on client port even when there are shards
+bool readConfig(int argc, char* argv[], ServerConfig& config, bool isRouter);
+
+// Prints effective configuration
+void printConfig(const ServerConfig& config, bool isRouter);
+
+// Pins current thread to core. Returns false if it is not supported or core is wrong
+bool pinThread(int core);
@@ -0,0 +1,42 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+#include "Expiry.h"
+
+std::mutex timerWheelMutex; // Guards wheel. Never held while other mutex is taken
+std::vector<ExpiryTimer> timerWheel[kTimerWheelSlots];
+uint64_t wheelTick = 0; // Last checked tick. Its slot is checked again, because it could get timers later
+
+// Current time for deadlines and activity, ms
+uint64_t tickCount() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Puts timer to wheel
+void scheduleExpiry(const ExpiryTimer& timer) {
+    timerWheelMutex.lock();
+    // Timer of passed tick goes to current slot, so it isn't left for whole turn
+    uint64_t tick = (std::max)(timer.deadline / kExpiryTick, wheelTick);
+    timerWheel[tick % kTimerWheelSlots].push_back(timer);
+    timerWheelMutex.unlock();
+}
+
+// Takes timers whose deadline has passed
+void takeExpiredTimers(uint64_t now, std::vector<ExpiryTimer>& expired) {
+    timerWheelMutex.lock();
+    uint64_t nowTick = now / kExpiryTick;
+    uint64_t ticks = (std::min)(nowTick - (std::min)(wheelTick, nowTick) + 1, (uint64_t)kTimerWheelSlots);
+
+    // Slots passed since last check. Timers of next turns stay in slot
+    for (uint64_t i = 0; i < ticks; ++i) {
+        std::vector<ExpiryTimer>& slot = timerWheel[(nowTick - i) % kTimerWheelSlots];
+        auto firstExpired = std::partition(slot.begin(), slot.end(),
+            [now](const ExpiryTimer& timer) { return timer.deadline > now; });
+        expired.insert(expired.end(), firstExpired, slot.end());
+        slot.erase(firstExpired, slot.end());
+    }
+    wheelTick = nowTick;
+    timerWheelMutex.unlock();
+}
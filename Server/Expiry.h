@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Idle expiry of users and games. Users and games keep time of their last activity,
+// timer wheel wakes reaper when their timeout could pass. Activity only stores time,
+// so timer which fires before timeout passes is put back for the rest of timeout.
+// Every user and game has one timer at a time, so wheel takes memory only for existing ones.
+const int kTimerWheelSlots = 512; // Wheel turns one slot per tick, longer timeouts take several turns
+const int kExpiryTick = 1000; // How often reaper checks timers, ms
+
+// Idle timeouts, ms. 0 - never expire. Set from config at start
+inline uint64_t userIdleTimeout = 0;
+inline uint64_t gameIdleTimeout = 0;
+
+typedef struct structExpiryTimer {
+    uint64_t deadline; // tickCount() when timer fires
+    int number; // Number of user or game slot
+    uint64_t id; // UID of user or ID of game, slot could be given to other one
+    bool isGame;
+} ExpiryTimer;
+
+// Current time for deadlines and activity, ms
+uint64_t tickCount();
+
+// Puts timer to wheel
+void scheduleExpiry(const ExpiryTimer& timer);
+
+// Takes timers whose deadline has passed
+void takeExpiredTimers(uint64_t now, std::vector<ExpiryTimer>& expired);
@@ -2,29 +2,178 @@
 #include <iostream>
 
 #include "Games.h"
+#include "ServerConnection.h"
+#include "Sharding.h"
+#include "Logger.h"
+#include "Expiry.h"
 
-structGame::structGame(std::string gameName, std::string playerUID) {
-    name = gameName;
+structGame::structGame() {
+    player[0] = player[1] = 0;
+    lastActivity[0] = lastActivity[1] = 0;
+    id = 0;
+    isStarted = -1;
+}
 
-    field = std::vector<std::vector<int>>(10, std::vector<int>(20, 0));
+structGame::structGame(std::string gameName, uint64_t playerUID, int gameID) : structGame() {
+    name = gameName;
+    id = gameID;
     player[0] = playerUID;
-    isStarted = -1;
+    lastActivity[0] = lastActivity[1] = tickCount();
 
-    std::cout << "Game created with name {" << gameName << "}." << std::endl;
+    logInfo("Game created with name {", gameName, "}.");
 }
 
-// Check if Game name is occupied
-bool uniqueGameName(std::string name) {
-    for (Game g : games)
-        if (g.name == name)
-            return false;
+// Adds change of open games list
+void addGameListChange(bool isOpened, const std::string& name) {
+    gameListChanges.push_back({ ++gameListVersion, isOpened, name });
+    if (gameListChanges.size() > kMaxGameListChanges)
+        gameListChanges.pop_front();
+}
+
+// Creates game in free slot. New ID is given if gameID is 0. Returns number of game
+int addGame(const std::string& gameName, uint64_t playerUID, int gameID) {
+    // Game ID keeps number of shard. IDs below shard count are never given, router uses them as game list cursors
+    if (gameID == 0)
+        gameID = (lastGameID / shardCount + 1) * shardCount + shardNumber;
+    if (gameID > lastGameID)
+        lastGameID = gameID;
+
+    int gameNumber;
+    if (freeGameSlots.empty()) {
+        gameNumber = games.size();
+        games.emplace_back();
+        gameMutexes.emplace_back();
+    }
+    else {
+        gameNumber = freeGameSlots.back();
+        freeGameSlots.pop_back();
+    }
+
+    // Threads which found old game of slot check its ID under game mutex. Slot is free, so taking
+    // its mutex under games mutex doesn't break lock order (see gameMutexes)
+    std::lock_guard<std::mutex> lock(gameMutexes[gameNumber]);
+    games[gameNumber] = Game(gameName, playerUID, gameID);
+    gamesByName[games[gameNumber].name] = gameNumber;
+    gamesByID[games[gameNumber].id] = gameNumber;
+
+    openGames[games[gameNumber].id] = gameNumber;
+    addGameListChange(true, games[gameNumber].name);
+
+    if (gameIdleTimeout != 0)
+        scheduleExpiry({ games[gameNumber].lastActivity[0] + gameIdleTimeout, gameNumber, (uint64_t)gameID, true });
+    return gameNumber;
+}
+
+// Removes game and frees its slot
+void removeGame(int gameNumber) {
+    if (openGames.erase(games[gameNumber].id) != 0)
+        addGameListChange(false, games[gameNumber].name);
+    gamesByName.erase(games[gameNumber].name);
+    gamesByID.erase(games[gameNumber].id);
+    games[gameNumber] = Game();
+    freeGameSlots.push_back(gameNumber);
+}
+
+// Sets second player of game and removes game from open games
+void joinSecondPlayer(int gameNumber, uint64_t playerUID) {
+    games[gameNumber].player[1] = playerUID;
+    games[gameNumber].lastActivity[1] = tickCount();
+    if (openGames.erase(games[gameNumber].id) != 0)
+        addGameListChange(false, games[gameNumber].name);
+}
+
+// Gets full open games list "#Game1#Game2..."
+std::string openGamesList() {
+    std::lock_guard<std::mutex> lock(gameListCacheMutex);
+    if (gameListCacheVersion != gameListVersion) {
+        gameListCache.clear();
+        appendOpenGames(gameListCache, 0, (int)openGames.size());
+        gameListCacheVersion = gameListVersion;
+    }
+    return gameListCache;
+}
+
+// Appends open games with ID after cursor to list "#Game1#Game2...". Returns cursor of next page, 0 - no more games
+int appendOpenGames(std::string& list, int cursor, int limit) {
+    auto game = openGames.upper_bound(cursor);
+    for (int i = 0; i < limit && game != openGames.end(); ++i, ++game) {
+        list += kMessagePartsDelimiter;
+        list += games[game->second].name;
+        cursor = game->first;
+    }
+
+    if (game == openGames.end())
+        return 0;
+    return cursor;
+}
+
+// Appends changes after version "#+Game1#-Game2...". Returns false if changes are too old
+bool appendGameListChanges(std::string& list, uint64_t version) {
+    if (version > gameListVersion)
+        return false;
+    if (version == gameListVersion)
+        return true;
+    if (gameListChanges.empty() || gameListChanges.front().version > version + 1)
+        return false;
+
+    for (auto change = gameListChanges.begin() + (version + 1 - gameListChanges.front().version);
+        change != gameListChanges.end(); ++change) {
+        list += kMessagePartsDelimiter;
+        list += change->isOpened ? '+' : '-';
+        list += change->name;
+    }
     return true;
 }
 
-// Gets number of game in games
-int searchGameByName(std::string name) {
-    for (int i = 0; i < games.size(); ++i)
-        if (games[i].name == name)
-            return i;
+// Places player's field. Returns -1 if player has already placed field, 1 if both fields are placed
+// and game starts, 0 if game waits for other player
+int submitField(Game& game, int player, const Board& ships) {
+    if (game.fields[player].ships.any())
+        return -1;
+
+    placeFleet(game.fields[player], ships);
+    if (game.isStarted == -1) {
+        game.isStarted = 0;
+        return 0;
+    }
+    game.isStarted = 1;
+    return 1;
+}
+
+// Gets number of player whose turn it is. First player moves first and turn passes only on miss.
+// Cell is never shot twice, so number of misses gives turn without keeping it in game
+int moverOf(const Game& game) {
+    return (game.fields[0].misses.count() + game.fields[1].misses.count()) % 2;
+}
+
+// Gets number of player of game by UID. Returns -1 if user doesn't play this game
+int searchPlayer(const Game& game, uint64_t playerUID) {
+    if (playerUID == 0)
+        return -1;
+    if (playerUID == game.player[0])
+        return 0;
+    if (playerUID == game.player[1])
+        return 1;
     return -1;
 }
+
+// Check if Game name is occupied
+bool uniqueGameName(std::string_view name) {
+    return gamesByName.find(name) == gamesByName.end();
+}
+
+// Gets number of game in games by name
+int searchGameByName(std::string_view name) {
+    auto game = gamesByName.find(name);
+    if (game == gamesByName.end())
+        return -1;
+    return game->second;
+}
+
+// Gets number of game in games by ID
+int searchGameByID(int gameID) {
+    auto game = gamesByID.find(gameID);
+    if (game == gamesByID.end())
+        return -1;
+    return game->second;
+}
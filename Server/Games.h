@@ -1,16 +1,97 @@
 #pragma once
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+
+#include "Rules.h"
 
 typedef struct structGame {
-    std::vector<std::vector<int>> field; // First player [0-9], second player [10-19]
-    std::string player[2], name;
-    int isStarted;
-    structGame(std::string gameName, std::string playerName);
+    PlayerField fields[2]; // Field of every player
+    uint64_t player[2]; // UID of players, 0 - no player
+    uint64_t lastActivity[2]; // tickCount() of last move of every player. Player who moved last waits for other
+    std::string name;
+    int id; // Unique game ID, 0 - free slot
+    int isStarted; // -1 - no field is placed, 0 - one field is placed, 1 - both fields are placed and game goes
+    structGame();
+    structGame(std::string gameName, uint64_t playerUID, int gameID);
 } Game;
 
-__declspec(selectany) std::vector<Game> games;
+// Slots with games. Deque keeps games in place, removed games free their slot for reuse
+inline std::deque<Game> games;
+inline std::vector<int> freeGameSlots;
+// Mutex of every slot. Guards game state, so games are handled in parallel.
+// Lock order: game mutex, then games mutex. The only exception is addGame, which locks mutex of free slot
+// under games mutex. Mutex of free slot is held only to see that its game is gone, never while waiting
+// for games mutex, so this can't deadlock. Code which holds game mutex of free slot must keep it so
+inline std::deque<std::mutex> gameMutexes;
+
+// Indexes for games: Name -> number of game, ID -> number of game.
+// Name keys are views of games names, so they can be searched by view without copy
+inline std::unordered_map<std::string_view, int> gamesByName;
+inline std::unordered_map<int, int> gamesByID;
+
+// Last given game ID
+inline int lastGameID = 0;
+
+// Open games list. Game is open while it waits for second player. Guarded by games mutex.
+// Every change of list increases version and is kept in changes log, so clients can get delta
+typedef struct structGameListChange {
+    uint64_t version;
+    bool isOpened; // Game is opened or closed
+    std::string name;
+} GameListChange;
+
+const int kMaxGameListChanges = 1024; // Older changes are dropped, clients asking for them reload list
+const int kMaxGameListPage = 100;
+
+inline std::map<int, int> openGames; // Game ID -> number of game, ordered by ID for paging
+inline uint64_t gameListVersion = 0;
+inline std::deque<GameListChange> gameListChanges;
+
+// Full open games list "#Game1#Game2..." built once per version. Guarded by its own mutex,
+// because it is rebuilt by readers holding games mutex shared
+inline std::mutex gameListCacheMutex;
+inline std::string gameListCache;
+inline uint64_t gameListCacheVersion = 0;
+
+// Creates game in free slot. New ID is given if gameID is 0. Returns number of game
+int addGame(const std::string& gameName, uint64_t playerUID, int gameID = 0);
+
+// Removes game and frees its slot. Called with games mutex and game mutex taken
+void removeGame(int gameNumber);
+
+// Sets second player of game and removes game from open games
+void joinSecondPlayer(int gameNumber, uint64_t playerUID);
+
+// Gets full open games list "#Game1#Game2..."
+std::string openGamesList();
+
+// Appends open games with ID after cursor to list "#Game1#Game2...". Returns cursor of next page, 0 - no more games
+int appendOpenGames(std::string& list, int cursor, int limit);
+
+// Appends changes after version "#+Game1#-Game2...". Returns false if changes are too old
+bool appendGameListChanges(std::string& list, uint64_t version);
+
+// Places player's field. Returns -1 if player has already placed field, 1 if both fields are placed
+// and game starts, 0 if game waits for other player
+int submitField(Game& game, int player, const Board& ships);
+
+// Gets number of player whose turn it is
+int moverOf(const Game& game);
+
+// Gets number of player of game by UID. Returns -1 if user doesn't play this game
+int searchPlayer(const Game& game, uint64_t playerUID);
 
 // Check if Game name is occupied
-bool uniqueGameName(std::string name);
+bool uniqueGameName(std::string_view name);
+
+// Gets number of game in games by name
+int searchGameByName(std::string_view name);
 
-// Gets number of game in games
-int searchGameByName(std::string name);
+// Gets number of game in games by ID
+int searchGameByID(int gameID);
@@ -0,0 +1,511 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "Journal.h"
+#include "BinaryProtocol.h"
+#include "Sharding.h"
+#include "Logger.h"
+
+const uint32_t kSnapshotMagic = 0x31534253; // "SBS1"
+const int kRecordHeaderSize = 8;
+const int kSnapshotHeaderSize = 16;
+
+std::mutex journalMutex; // Guards pending records and LSN
+std::condition_variable journalCondition;
+std::string pendingRecords; // Records waiting for journal thread
+uint64_t lastLSN = 0; // LSN of last added record
+FILE* journalFile = nullptr;
+std::string journalFileName, snapshotFileName; // Every shard has own files
+
+// ===========================================================================================
+//
+//                                   Records encoding
+//
+// ===========================================================================================
+
+// Checksum of record body (FNV-1a)
+uint32_t recordChecksum(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Appends number in little-endian byte order
+template<typename T>
+void appendValue(std::string& data, T value) {
+    data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Appends string with its length
+void appendText(std::string& data, std::string_view text) {
+    appendValue<uint16_t>(data, (uint16_t)text.size());
+    data.append(text.data(), text.size());
+}
+
+// Appends field packed one bit per cell
+void appendBoard(std::string& data, const Board& board) {
+    uint8_t bitmap[kFieldBitmapSize] = {};
+    for (int row = 0; row < kFieldSize; ++row)
+        for (int column = 0; column < kFieldSize; ++column)
+            if (board.test(row * kBoardStride + column))
+                setFieldBit(bitmap, row, column);
+    data.append(reinterpret_cast<const char*>(bitmap), kFieldBitmapSize);
+}
+
+// Appends record with header
+void appendRecord(std::string& data, uint64_t lsn, uint8_t type, const std::string& payload) {
+    size_t start = data.size();
+    appendValue<uint32_t>(data, (uint32_t)(sizeof(lsn) + sizeof(type) + payload.size()));
+    appendValue<uint32_t>(data, 0);
+    appendValue(data, lsn);
+    appendValue(data, type);
+    data += payload;
+
+    uint32_t checksum = recordChecksum(&data[start + kRecordHeaderSize], data.size() - start - kRecordHeaderSize);
+    std::memcpy(&data[start + sizeof(uint32_t)], &checksum, sizeof(checksum));
+}
+
+// Adds record to pending records. Journal thread writes them
+void addRecord(uint8_t type, const std::string& payload) {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    appendRecord(pendingRecords, ++lastLSN, type, payload);
+    journalCondition.notify_one();
+}
+
+void journalUserAdded(uint64_t uniqueID, std::string_view login) {
+    std::string payload;
+    appendValue(payload, uniqueID);
+    appendText(payload, login);
+    addRecord(kJournalUserAdded, payload);
+}
+
+void journalGameCreated(int gameID, uint64_t playerUID, std::string_view gameName) {
+    std::string payload;
+    appendValue<uint32_t>(payload, gameID);
+    appendValue(payload, playerUID);
+    appendText(payload, gameName);
+    addRecord(kJournalGameCreated, payload);
+}
+
+void journalGameJoined(int gameID, uint64_t playerUID) {
+    std::string payload;
+    appendValue<uint32_t>(payload, gameID);
+    appendValue(payload, playerUID);
+    addRecord(kJournalGameJoined, payload);
+}
+
+void journalFieldPlaced(int gameID, int player, const Board& ships) {
+    std::string payload;
+    appendValue<uint32_t>(payload, gameID);
+    appendValue<uint8_t>(payload, player);
+    appendBoard(payload, ships);
+    addRecord(kJournalFieldPlaced, payload);
+}
+
+void journalShot(int gameID, int player, int row, int column) {
+    std::string payload;
+    appendValue<uint32_t>(payload, gameID);
+    appendValue<uint8_t>(payload, player);
+    appendValue<uint8_t>(payload, row);
+    appendValue<uint8_t>(payload, column);
+    addRecord(kJournalShot, payload);
+}
+
+void journalGameRemoved(int gameID) {
+    std::string payload;
+    appendValue<uint32_t>(payload, gameID);
+    addRecord(kJournalGameRemoved, payload);
+}
+
+void journalUserRemoved(uint64_t uniqueID) {
+    std::string payload;
+    appendValue(payload, uniqueID);
+    addRecord(kJournalUserRemoved, payload);
+}
+
+// Adds user to snapshot
+void appendSnapshotUser(std::string& snapshot, const User& user) {
+    std::string payload;
+    appendValue(payload, user.uniqueID);
+    appendText(payload, user.login);
+    appendText(payload, user.gameName);
+    appendRecord(snapshot, 0, kSnapshotUser, payload);
+}
+
+// Adds game to snapshot
+void appendSnapshotGame(std::string& snapshot, const Game& game) {
+    std::string payload;
+    appendValue<uint32_t>(payload, game.id);
+    appendValue<int8_t>(payload, game.isStarted);
+    appendValue(payload, game.player[0]);
+    appendValue(payload, game.player[1]);
+    appendText(payload, game.name);
+    for (int player = 0; player < 2; ++player) {
+        appendBoard(payload, game.fields[player].ships);
+        appendBoard(payload, game.fields[player].hits);
+        appendBoard(payload, game.fields[player].misses);
+    }
+    appendRecord(snapshot, 0, kSnapshotGame, payload);
+}
+
+// ===========================================================================================
+//
+//                                   Records replay
+//
+// ===========================================================================================
+
+typedef struct structRecordReader {
+    const char* data;
+    size_t size;
+    size_t position;
+    bool isCorrect;
+} RecordReader;
+
+// Reads number. Marks reader incorrect if record is too short
+template<typename T>
+T readValue(RecordReader& reader) {
+    T value = T();
+    if (reader.position + sizeof(T) > reader.size) {
+        reader.isCorrect = false;
+        return value;
+    }
+    std::memcpy(&value, reader.data + reader.position, sizeof(T));
+    reader.position += sizeof(T);
+    return value;
+}
+
+// Reads string with its length
+std::string readText(RecordReader& reader) {
+    uint16_t size = readValue<uint16_t>(reader);
+    if (reader.position + size > reader.size) {
+        reader.isCorrect = false;
+        return "";
+    }
+    reader.position += size;
+    return std::string(reader.data + reader.position - size, size);
+}
+
+// Reads field packed one bit per cell
+Board readBoard(RecordReader& reader) {
+    Board board;
+    if (reader.position + kFieldBitmapSize > reader.size) {
+        reader.isCorrect = false;
+        return board;
+    }
+
+    const uint8_t* bitmap = reinterpret_cast<const uint8_t*>(reader.data + reader.position);
+    for (int row = 0; row < kFieldSize; ++row)
+        for (int column = 0; column < kFieldSize; ++column)
+            if (getFieldBit(bitmap, row, column))
+                board |= cellBoard(row, column);
+    reader.position += kFieldBitmapSize;
+    return board;
+}
+
+// Sets game name of user
+void setUserGameName(uint64_t uniqueID, const std::string& gameName) {
+    User* user = getUserByUID(uniqueID);
+    if (user != nullptr)
+        user->gameName = gameName;
+}
+
+// Applies record to users and games. Changes already made are skipped
+void applyRecord(uint8_t type, RecordReader& reader) {
+    switch (type) {
+    case kJournalUserAdded:
+    case kSnapshotUser: {
+        uint64_t uniqueID = readValue<uint64_t>(reader);
+        std::string login = readText(reader);
+        std::string gameName = type == kSnapshotUser ? readText(reader) : "";
+        if (!reader.isCorrect || !uniqueIdentity(uniqueID) || !uniqueUserLogin(login))
+            break;
+
+        int userNumber = addUser(login, uniqueID);
+        if (userNumber != -1)
+            users[userNumber].gameName = gameName;
+        break;
+    }
+    case kJournalGameCreated: {
+        int gameID = readValue<uint32_t>(reader);
+        uint64_t playerUID = readValue<uint64_t>(reader);
+        std::string gameName = readText(reader);
+        if (!reader.isCorrect || searchGameByID(gameID) != -1 || !uniqueGameName(gameName))
+            break;
+
+        addGame(gameName, playerUID, gameID);
+        setUserGameName(playerUID, gameName);
+        break;
+    }
+    case kJournalGameJoined: {
+        int gameNumber = searchGameByID(readValue<uint32_t>(reader));
+        uint64_t playerUID = readValue<uint64_t>(reader);
+        if (!reader.isCorrect || gameNumber == -1 || games[gameNumber].player[1] != 0)
+            break;
+
+        joinSecondPlayer(gameNumber, playerUID);
+        setUserGameName(playerUID, games[gameNumber].name);
+        break;
+    }
+    case kJournalFieldPlaced: {
+        int gameNumber = searchGameByID(readValue<uint32_t>(reader));
+        int player = readValue<uint8_t>(reader);
+        Board ships = readBoard(reader);
+        if (reader.isCorrect && gameNumber != -1 && player < 2)
+            submitField(games[gameNumber], player, ships);
+        break;
+    }
+    case kJournalShot: {
+        int gameNumber = searchGameByID(readValue<uint32_t>(reader));
+        int player = readValue<uint8_t>(reader);
+        int row = readValue<uint8_t>(reader), column = readValue<uint8_t>(reader);
+        if (reader.isCorrect && gameNumber != -1 && player < 2 && correctCoordinate(row) && correctCoordinate(column))
+            shootAt(games[gameNumber].fields[player], row, column);
+        break;
+    }
+    case kJournalGameRemoved: {
+        int gameNumber = searchGameByID(readValue<uint32_t>(reader));
+        if (reader.isCorrect && gameNumber != -1)
+            removeGame(gameNumber);
+        break;
+    }
+    case kJournalUserRemoved: {
+        int userNumber = searchUserByUID(readValue<uint64_t>(reader));
+        // Nobody holds pointers while state is loaded, so slot is reused at once. Later users can take it
+        if (reader.isCorrect && userNumber != -1) {
+            removeUser(userNumber);
+            reuseUserSlots(UINT64_MAX);
+        }
+        break;
+    }
+    case kSnapshotGame: {
+        int gameID = readValue<uint32_t>(reader);
+        int isStarted = readValue<int8_t>(reader);
+        uint64_t player[2];
+        player[0] = readValue<uint64_t>(reader);
+        player[1] = readValue<uint64_t>(reader);
+        std::string gameName = readText(reader);
+        Board ships[2], hits[2], misses[2];
+        for (int i = 0; i < 2; ++i) {
+            ships[i] = readBoard(reader);
+            hits[i] = readBoard(reader);
+            misses[i] = readBoard(reader);
+        }
+        if (!reader.isCorrect || searchGameByID(gameID) != -1 || !uniqueGameName(gameName))
+            break;
+
+        int gameNumber = addGame(gameName, player[0], gameID);
+        Game& game = games[gameNumber];
+        if (player[1] != 0)
+            joinSecondPlayer(gameNumber, player[1]);
+        game.isStarted = isStarted;
+
+        // Hits are made again, so ship counters are restored too
+        for (int i = 0; i < 2; ++i) {
+            placeFleet(game.fields[i], ships[i]);
+            game.fields[i].misses = misses[i];
+            for (int row = 0; row < kFieldSize; ++row)
+                for (int column = 0; column < kFieldSize; ++column)
+                    if (hits[i].test(row * kBoardStride + column))
+                        shootAt(game.fields[i], row, column);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// Applies records with LSN after given one. Updates last LSN. Returns size of correct records,
+// records after broken or unfinished one are ignored
+size_t replayRecords(const std::string& data, size_t position, uint64_t afterLSN) {
+    while (position + kRecordHeaderSize <= data.size()) {
+        uint32_t bodySize, checksum;
+        std::memcpy(&bodySize, &data[position], sizeof(bodySize));
+        std::memcpy(&checksum, &data[position + sizeof(bodySize)], sizeof(checksum));
+
+        const char* body = &data[position + kRecordHeaderSize];
+        if (position + kRecordHeaderSize + bodySize > data.size() || recordChecksum(body, bodySize) != checksum)
+            break;
+
+        RecordReader reader = { body, bodySize, 0, true };
+        uint64_t lsn = readValue<uint64_t>(reader);
+        uint8_t type = readValue<uint8_t>(reader);
+        if (!reader.isCorrect)
+            break;
+
+        if (lsn == 0 || lsn > afterLSN)
+            applyRecord(type, reader);
+        if (lsn > lastLSN)
+            lastLSN = lsn;
+        position += kRecordHeaderSize + bodySize;
+    }
+    return position;
+}
+
+// Reads whole file. Returns false if there is no file
+bool readFile(const char* fileName, std::string& data) {
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+
+    data.resize((size_t)file.tellg());
+    file.seekg(0);
+    file.read(&data[0], data.size());
+    return (bool)file;
+}
+
+// Gets name of journal or snapshot file of this shard: "journal.bin" -> "journal-1.bin"
+std::string shardFileName(const char* fileName) {
+    std::string name = fileName;
+    if (shardCount == 1)
+        return name;
+    size_t extension = name.rfind('.');
+    return name.substr(0, extension) + "-" + std::to_string(shardNumber) + name.substr(extension);
+}
+
+// Loads snapshot and replays journal. Called before workers start
+void loadState() {
+    journalFileName = shardFileName(kJournalFile);
+    snapshotFileName = shardFileName(kSnapshotFile);
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t snapshotLSN = 0;
+    std::string data;
+
+    if (readFile(snapshotFileName.c_str(), data) && data.size() >= kSnapshotHeaderSize) {
+        uint32_t magic, snapshotLastGameID;
+        std::memcpy(&magic, &data[0], sizeof(magic));
+        std::memcpy(&snapshotLSN, &data[4], sizeof(snapshotLSN));
+        std::memcpy(&snapshotLastGameID, &data[12], sizeof(snapshotLastGameID));
+
+        if (magic == kSnapshotMagic) {
+            replayRecords(data, kSnapshotHeaderSize, 0);
+            lastGameID = (std::max)(lastGameID, (int)snapshotLastGameID);
+            lastLSN = snapshotLSN;
+        }
+        else {
+            logError("Snapshot ", snapshotFileName, " is broken and is not loaded");
+            snapshotLSN = 0;
+        }
+    }
+
+    if (readFile(journalFileName.c_str(), data)) {
+        size_t correctSize = replayRecords(data, 0, snapshotLSN);
+
+        // Unfinished record of crashed server is cut, so new records are not lost behind it
+        if (correctSize < data.size()) {
+            logWarning("Journal has broken tail of ", data.size() - correctSize, " bytes, it is cut");
+            std::filesystem::resize_file(journalFileName, correctSize);
+        }
+    }
+
+    auto time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    logInfo("Loaded ", usersByLogin.size(), " users and ", games.size() - freeGameSlots.size(),
+        " games in ", time.count(), " ms");
+}
+
+// ===========================================================================================
+//
+//                                   Journal thread
+//
+// ===========================================================================================
+
+// Writes data to disk
+void syncFile(FILE* file) {
+    std::fflush(file);
+#ifdef _WIN32
+    _commit(_fileno(file));
+#else
+    fsync(fileno(file));
+#endif
+}
+
+// Writes snapshot of state with all records up to LSN, then starts journal anew
+void writeSnapshot(int (*collectSnapshot)(std::string& snapshot), uint64_t lsn) {
+    std::string snapshot;
+    appendValue(snapshot, kSnapshotMagic);
+    appendValue(snapshot, lsn);
+    appendValue<uint32_t>(snapshot, 0);
+    uint32_t snapshotLastGameID = collectSnapshot(snapshot);
+    std::memcpy(&snapshot[12], &snapshotLastGameID, sizeof(snapshotLastGameID));
+
+    // Old snapshot is replaced only by completely written new one
+    std::string temporaryFile = snapshotFileName + ".tmp";
+    FILE* file = std::fopen(temporaryFile.c_str(), "wb");
+    if (file == nullptr) {
+        logError("Unable to write snapshot ", temporaryFile);
+        return;
+    }
+    std::fwrite(snapshot.data(), 1, snapshot.size(), file);
+    syncFile(file);
+    std::fclose(file);
+
+    std::error_code error;
+    std::filesystem::rename(temporaryFile, snapshotFileName, error);
+    if (error) {
+        logError("Unable to replace snapshot ", snapshotFileName, ": ", error.message());
+        return;
+    }
+
+    // Every written record is in snapshot now
+    if (journalFile != nullptr)
+        std::fclose(journalFile);
+    journalFile = std::fopen(journalFileName.c_str(), "wb");
+}
+
+// Journal thread. Writes all pending records at once, so many changes share one disk sync
+void journalThread(int (*collectSnapshot)(std::string& snapshot)) {
+    std::string batch;
+    uint64_t batchLSN = 0, snapshotLSN = 0;
+    auto lastSnapshot = std::chrono::steady_clock::now();
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(journalMutex);
+            journalCondition.wait_for(lock, std::chrono::milliseconds(kJournalFlushInterval),
+                [] { return !pendingRecords.empty(); });
+            batch.swap(pendingRecords);
+            batchLSN = lastLSN;
+        }
+
+        if (!batch.empty() && journalFile != nullptr) {
+            std::fwrite(batch.data(), 1, batch.size(), journalFile);
+            syncFile(journalFile);
+        }
+        batch.clear();
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastSnapshot >= std::chrono::milliseconds(kSnapshotInterval)) {
+            if (batchLSN != snapshotLSN)
+                writeSnapshot(collectSnapshot, batchLSN);
+            snapshotLSN = batchLSN;
+            lastSnapshot = now;
+        }
+    }
+}
+
+// Starts journal thread. collectSnapshot adds all users and games to snapshot taking locks it needs
+// and returns last given game ID
+void startJournal(int (*collectSnapshot)(std::string& snapshot)) {
+    journalFile = std::fopen(journalFileName.c_str(), "ab");
+    if (journalFile == nullptr)
+        logError("Unable to open journal ", journalFileName, ", changes are not saved");
+
+    std::thread(journalThread, collectSnapshot).detach();
+}
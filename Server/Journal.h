@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "Rules.h"
+#include "Users.h"
+#include "Games.h"
+
+// Append-only journal of state changes and snapshots of whole state.
+// Handlers add records to memory buffer under the same lock as the change they describe,
+// journal thread writes buffer in batches (group commit), so handlers never wait for disk.
+// Snapshot is written by journal thread from time to time, then journal is started anew.
+// On start state is loaded from snapshot and journal records after snapshot are replayed.
+// Replay is idempotent, so records already seen by snapshot change nothing.
+//
+// Record: [u32 body size][u32 checksum of body][body: u64 LSN, u8 type, payload]
+// Snapshot: [u32 kSnapshotMagic][u64 LSN of last journal record in snapshot][u32 last game ID][records]
+const char kJournalFile[] = "journal.bin";
+const char kSnapshotFile[] = "snapshot.bin";
+const int kJournalFlushInterval = 5; // How long journal thread waits for more records, ms
+const int kSnapshotInterval = 60000; // How often snapshot is written, ms
+
+// Types of records
+const uint8_t kJournalUserAdded = 1;   // UID, login
+const uint8_t kJournalGameCreated = 2; // game ID, UID, game name
+const uint8_t kJournalGameJoined = 3;  // game ID, UID
+const uint8_t kJournalFieldPlaced = 4; // game ID, player, field
+const uint8_t kJournalShot = 5;        // game ID, player at whose field shot is made, row, column
+const uint8_t kJournalGameRemoved = 6; // game ID
+const uint8_t kSnapshotUser = 7;       // UID, login, game name
+const uint8_t kSnapshotGame = 8;       // game ID, started, players, game name, ships, hits, misses
+const uint8_t kJournalUserRemoved = 9; // UID
+
+// Adds records to journal. Called under lock of changed state
+void journalUserAdded(uint64_t uniqueID, std::string_view login);
+void journalGameCreated(int gameID, uint64_t playerUID, std::string_view gameName);
+void journalGameJoined(int gameID, uint64_t playerUID);
+void journalFieldPlaced(int gameID, int player, const Board& ships);
+void journalShot(int gameID, int player, int row, int column);
+void journalGameRemoved(int gameID);
+void journalUserRemoved(uint64_t uniqueID);
+
+// Adds user or game to snapshot
+void appendSnapshotUser(std::string& snapshot, const User& user);
+void appendSnapshotGame(std::string& snapshot, const Game& game);
+
+// Loads snapshot and replays journal. Called before workers start
+void loadState();
+
+// Starts journal thread. collectSnapshot adds all users and games to snapshot taking locks it needs
+// and returns last given game ID
+void startJournal(int (*collectSnapshot)(std::string& snapshot));
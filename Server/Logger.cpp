@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Logger.h"
+
+std::mutex logBuffersMutex; // Guards list of buffers. Taken once per thread and by logger thread
+std::vector<std::unique_ptr<LogBuffer>> logBuffers;
+std::mutex logFileMutex; // Only one thread writes to log file
+FILE* logFile = stdout;
+thread_local LogBuffer* threadLogBuffer = nullptr;
+
+structLogBuffer::structLogBuffer(int threadNumber) {
+    writePosition = 0;
+    readPosition = 0;
+    droppedRecords = 0;
+    thread = threadNumber;
+}
+
+// Starts record in buffer of current thread. Returns nullptr if buffer is full
+LogRecord* beginLogRecord(int level) {
+    // Buffer of thread is made at first record
+    if (threadLogBuffer == nullptr) {
+        logBuffersMutex.lock();
+        logBuffers.push_back(std::make_unique<LogBuffer>((int)logBuffers.size()));
+        threadLogBuffer = logBuffers.back().get();
+        logBuffersMutex.unlock();
+    }
+
+    LogBuffer& buffer = *threadLogBuffer;
+    uint32_t position = buffer.writePosition.load(std::memory_order_relaxed);
+    if (position - buffer.readPosition.load(std::memory_order_acquire) == kLogBufferRecords) {
+        buffer.droppedRecords.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    LogRecord& record = buffer.records[position & (kLogBufferRecords - 1)];
+    record.time = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.level = (uint8_t)level;
+    record.size = 0;
+    return &record;
+}
+
+// Makes record visible to logger thread
+void commitLogRecord() {
+    threadLogBuffer->writePosition.fetch_add(1, std::memory_order_release);
+}
+
+// Gets level by name: debug, info, warning, error. Returns -1 if name is wrong
+int logLevelByName(std::string_view name) {
+    for (int level = kLogDebug; level <= kLogError; ++level)
+        if (name == kLogLevelNames[level])
+            return level;
+    return -1;
+}
+
+// ===========================================================================================
+//
+//                                   Logger thread
+//
+// ===========================================================================================
+
+// Reads value of argument from record
+template<typename T>
+T readLogValue(const LogRecord& record, size_t& position) {
+    T value = T();
+    if (position + sizeof(T) <= record.size)
+        std::memcpy(&value, record.data + position, sizeof(T));
+    position += sizeof(T);
+    return value;
+}
+
+// Formats record as line "time level [thread] text"
+void formatLogRecord(const LogRecord& record, int thread, std::string& line) {
+    time_t seconds = (time_t)(record.time / 1000000);
+    tm localTime;
+#ifdef _WIN32
+    localtime_s(&localTime, &seconds);
+#else
+    localtime_r(&seconds, &localTime);
+#endif
+    char prefix[64];
+    std::snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%03d %-7s [%d] ", localTime.tm_hour, localTime.tm_min,
+        localTime.tm_sec, (int)(record.time / 1000 % 1000), kLogLevelNames[record.level], thread);
+    line += prefix;
+
+    size_t position = 0;
+    while (position < record.size) {
+        char type = record.data[position++];
+        switch (type) {
+        case kLogChar:
+            line += readLogValue<char>(record, position);
+            break;
+        case kLogSigned:
+            line += std::to_string(readLogValue<int64_t>(record, position));
+            break;
+        case kLogUnsigned:
+            line += std::to_string(readLogValue<uint64_t>(record, position));
+            break;
+        case kLogDouble:
+            line += std::to_string(readLogValue<double>(record, position));
+            break;
+        case kLogString: {
+            uint16_t size = readLogValue<uint16_t>(record, position);
+            size = (uint16_t)(std::min)((size_t)size, record.size - (std::min)(position, (size_t)record.size));
+            line.append(record.data + position, size);
+            position += size;
+            break;
+        }
+        default:
+            position = record.size;
+            break;
+        }
+    }
+    line += '\n';
+}
+
+// Takes records of all threads ordered by time and writes them. Returns number of records
+int writeLogRecords() {
+    std::vector<std::pair<uint64_t, std::string>> lines;
+    uint64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    logBuffersMutex.lock();
+    for (std::unique_ptr<LogBuffer>& buffer : logBuffers) {
+        uint32_t position = buffer->readPosition.load(std::memory_order_relaxed);
+        uint32_t end = buffer->writePosition.load(std::memory_order_acquire);
+        for (; position != end; ++position) {
+            const LogRecord& record = buffer->records[position & (kLogBufferRecords - 1)];
+            lines.emplace_back(record.time, std::string());
+            formatLogRecord(record, buffer->thread, lines.back().second);
+        }
+        buffer->readPosition.store(end, std::memory_order_release);
+
+        uint64_t dropped = buffer->droppedRecords.exchange(0, std::memory_order_relaxed);
+        if (dropped != 0)
+            lines.emplace_back(now, "Log of thread [" + std::to_string(buffer->thread) + "] is full, "
+                + std::to_string(dropped) + " records are dropped\n");
+    }
+    logBuffersMutex.unlock();
+
+    std::stable_sort(lines.begin(), lines.end(),
+        [](const auto& first, const auto& second) { return first.first < second.first; });
+
+    std::string text;
+    for (auto& line : lines)
+        text += line.second;
+
+    // File is flushed once per batch
+    logFileMutex.lock();
+    if (!text.empty()) {
+        std::fwrite(text.data(), 1, text.size(), logFile);
+        std::fflush(logFile);
+    }
+    logFileMutex.unlock();
+    return (int)lines.size();
+}
+
+// Logger thread. Writes records of all threads from time to time
+void loggerThread() {
+    while (true) {
+        writeLogRecords();
+        std::this_thread::sleep_for(std::chrono::milliseconds(kLogFlushInterval));
+    }
+}
+
+// Starts logger thread. Empty file name - stdout. Returns false if file can't be opened,
+// then log is written to stdout
+bool startLogger(const std::string& fileName) {
+    bool isOpened = true;
+    if (!fileName.empty()) {
+        FILE* file = std::fopen(fileName.c_str(), "a");
+        if (file != nullptr)
+            logFile = file;
+        else
+            isOpened = false;
+    }
+
+    std::thread(loggerThread).detach();
+    return isOpened;
+}
+
+// Writes all records. Called before exit
+void flushLogger() {
+    writeLogRecords();
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Asynchronous logger. Every thread writes records to its own lock-free ring buffer,
+// arguments are copied as they are and formatted later by logger thread, which writes them
+// to file or stdout in batches. Records of full buffer are dropped and counted, so logging never waits.
+// Disabled levels cost one comparison, but arguments are still evaluated, so pass parts instead of concatenation.
+const int kLogDebug = 0;
+const int kLogInfo = 1;
+const int kLogWarning = 2;
+const int kLogError = 3;
+
+const int kLogRecordSize = 240;    // Bytes of arguments in record, longer strings are cut
+const int kLogBufferRecords = 1024; // Records in buffer of one thread. Must be power of two
+const int kLogFlushInterval = 10;  // How often logger thread writes records, ms
+
+// Records with lower level are not written
+inline int logLevel = kLogInfo;
+const char* const kLogLevelNames[] = { "debug", "info", "warning", "error" };
+
+// Types of arguments in record
+const char kLogSigned = 'i';
+const char kLogUnsigned = 'u';
+const char kLogChar = 'c';
+const char kLogDouble = 'd';
+const char kLogString = 's';
+
+typedef struct structLogRecord {
+    uint64_t time; // Microseconds since epoch
+    uint8_t level;
+    uint16_t size; // Used bytes of data
+    char data[kLogRecordSize];
+} LogRecord;
+
+typedef struct structLogBuffer {
+    LogRecord records[kLogBufferRecords];
+    std::atomic<uint32_t> writePosition, readPosition;
+    std::atomic<uint64_t> droppedRecords;
+    int thread; // Number of thread in log
+    structLogBuffer(int threadNumber);
+} LogBuffer;
+
+// Starts record in buffer of current thread. Returns nullptr if buffer is full
+LogRecord* beginLogRecord(int level);
+
+// Makes record visible to logger thread
+void commitLogRecord();
+
+// Copies bytes to record. Bytes which don't fit are cut
+inline void appendLogBytes(LogRecord& record, const void* data, size_t size) {
+    size = (std::min)(size, (size_t)(kLogRecordSize - record.size));
+    std::memcpy(record.data + record.size, data, size);
+    record.size += (uint16_t)size;
+}
+
+// Copies argument to record with its type
+template<typename T>
+void appendLogArgument(LogRecord& record, const T& value) {
+    char type;
+    if constexpr (std::is_same_v<T, char>) {
+        type = kLogChar;
+        appendLogBytes(record, &type, 1);
+        appendLogBytes(record, &value, 1);
+    }
+    else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        int64_t number = value;
+        type = kLogSigned;
+        appendLogBytes(record, &type, 1);
+        appendLogBytes(record, &number, sizeof(number));
+    }
+    else if constexpr (std::is_integral_v<T>) {
+        uint64_t number = value;
+        type = kLogUnsigned;
+        appendLogBytes(record, &type, 1);
+        appendLogBytes(record, &number, sizeof(number));
+    }
+    else if constexpr (std::is_floating_point_v<T>) {
+        double number = value;
+        type = kLogDouble;
+        appendLogBytes(record, &type, 1);
+        appendLogBytes(record, &number, sizeof(number));
+    }
+    else {
+        std::string_view text = value;
+        uint16_t size = (uint16_t)(std::min)(text.size(), (size_t)kLogRecordSize);
+        type = kLogString;
+        appendLogBytes(record, &type, 1);
+        appendLogBytes(record, &size, sizeof(size));
+        appendLogBytes(record, text.data(), size);
+    }
+}
+
+// Adds record with arguments printed one after another
+template<typename... Args>
+void logMessage(int level, const Args&... args) {
+    if (level < logLevel)
+        return;
+
+    LogRecord* record = beginLogRecord(level);
+    if (record == nullptr)
+        return;
+    (appendLogArgument(*record, args), ...);
+    commitLogRecord();
+}
+
+template<typename... Args>
+void logDebug(const Args&... args) {
+    logMessage(kLogDebug, args...);
+}
+
+template<typename... Args>
+void logInfo(const Args&... args) {
+    logMessage(kLogInfo, args...);
+}
+
+template<typename... Args>
+void logWarning(const Args&... args) {
+    logMessage(kLogWarning, args...);
+}
+
+template<typename... Args>
+void logError(const Args&... args) {
+    logMessage(kLogError, args...);
+}
+
+// Gets level by name: debug, info, warning, error. Returns -1 if name is wrong
+int logLevelByName(std::string_view name);
+
+// Starts logger thread. Empty file name - stdout. Returns false if file can't be opened,
+// then log is written to stdout
+bool startLogger(const std::string& fileName);
+
+// Writes all records. Called before exit
+void flushLogger();
@@ -0,0 +1,67 @@
+#include "Mailbox.h"
+
+// Bounded queue by Dmitry Vyukov. Sequence of cell tells if cell is free for producer
+// (sequence == position) or has message for consumer (sequence == position + 1)
+structMailbox::structMailbox() {
+    for (int i = 0; i < kMailboxCapacity; ++i)
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    enqueuePosition.store(0, std::memory_order_relaxed);
+    dequeuePosition.store(0, std::memory_order_relaxed);
+    droppedMessages.store(0, std::memory_order_relaxed);
+}
+
+// Adds message to mailbox. Returns false if mailbox is full and message is dropped
+bool pushMessage(Mailbox& mailbox, const std::string& message) {
+    uint32_t position = mailbox.enqueuePosition.load(std::memory_order_relaxed);
+    MailboxCell* cell;
+    while (true) {
+        cell = &mailbox.cells[position & (kMailboxCapacity - 1)];
+        int32_t difference = (int32_t)(cell->sequence.load(std::memory_order_acquire) - position);
+
+        if (difference == 0) {
+            if (mailbox.enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0) {
+            mailbox.droppedMessages.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+            position = mailbox.enqueuePosition.load(std::memory_order_relaxed);
+    }
+
+    cell->message = message;
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+// Takes oldest message from mailbox. Returns false if mailbox is empty
+bool popMessage(Mailbox& mailbox, std::string& message) {
+    uint32_t position = mailbox.dequeuePosition.load(std::memory_order_relaxed);
+    MailboxCell* cell;
+    while (true) {
+        cell = &mailbox.cells[position & (kMailboxCapacity - 1)];
+        int32_t difference = (int32_t)(cell->sequence.load(std::memory_order_acquire) - (position + 1));
+
+        if (difference == 0) {
+            if (mailbox.dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+            return false;
+        else
+            position = mailbox.dequeuePosition.load(std::memory_order_relaxed);
+    }
+
+    message = std::move(cell->message);
+    cell->message.clear();
+    cell->sequence.store(position + kMailboxCapacity, std::memory_order_release);
+    return true;
+}
+
+// Gets number of messages in mailbox
+int mailboxSize(const Mailbox& mailbox) {
+    int size = (int)(mailbox.enqueuePosition.load(std::memory_order_relaxed)
+        - mailbox.dequeuePosition.load(std::memory_order_relaxed));
+    return size < 0 ? 0 : size;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Bounded lock-free queue of messages for one user. Any thread can add messages,
+// the thread handling user's request takes them. Messages over capacity are dropped and counted.
+const int kMailboxCapacity = 32; // Must be power of two
+
+typedef struct structMailboxCell {
+    std::atomic<uint32_t> sequence;
+    std::string message;
+} MailboxCell;
+
+typedef struct structMailbox {
+    MailboxCell cells[kMailboxCapacity];
+    std::atomic<uint32_t> enqueuePosition, dequeuePosition;
+    std::atomic<int> droppedMessages;
+    structMailbox();
+} Mailbox;
+
+// Adds message to mailbox. Returns false if mailbox is full and message is dropped
+bool pushMessage(Mailbox& mailbox, const std::string& message);
+
+// Takes oldest message from mailbox. Returns false if mailbox is empty
+bool popMessage(Mailbox& mailbox, std::string& message);
+
+// Gets number of messages in mailbox
+int mailboxSize(const Mailbox& mailbox);
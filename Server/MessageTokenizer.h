@@ -0,0 +1,34 @@
+#pragma once
+#include <string_view>
+
+// Tokenizer for text messages. Parts are views into message buffer, so nothing is copied or allocated.
+
+// Max parts in one request (field request has 13 parts)
+const int kMaxMessageParts = 16;
+
+typedef struct structMessageParts {
+    std::string_view part[kMaxMessageParts];
+    int size;
+} MessageParts;
+
+// Split message with delimiter. Returns false if message has too many parts
+inline bool splitMessage(std::string_view message, char delimiter, MessageParts& parts) {
+    parts.size = 0;
+    while (parts.size < kMaxMessageParts) {
+        size_t position = message.find(delimiter);
+        parts.part[parts.size++] = message.substr(0, position);
+        if (position == std::string_view::npos)
+            return true;
+        message.remove_prefix(position + 1);
+    }
+    return false;
+}
+
+// Gets first part of message and removes it with delimiter from message.
+// Used when number of parts is not limited (game list, saved messages)
+inline std::string_view takeMessagePart(std::string_view& message, char delimiter) {
+    size_t position = message.find(delimiter);
+    std::string_view part = message.substr(0, position);
+    message.remove_prefix(position == std::string_view::npos ? message.size() : position + 1);
+    return part;
+}
@@ -0,0 +1,121 @@
+#include <chrono>
+#include <algorithm>
+
+#include "Metrics.h"
+
+structHistogram::structHistogram() : count(0), sum(0), max(0) {
+    for (int i = 0; i < kHistogramBuckets; ++i)
+        buckets[i] = 0;
+}
+
+structServerMetrics::structServerMetrics() : failedRequests(0), workerBusyTime(0), workerIdleTime(0),
+    queuedRequests(0), expiredUsers(0), expiredGames(0) {}
+
+// Current time for metrics, microseconds
+uint64_t metricsClock() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Number of bucket for value
+int bucketIndex(uint64_t value) {
+    const uint64_t kMaxValue = (uint64_t(1) << kHistogramValueBits) - 1;
+    if (value > kMaxValue)
+        value = kMaxValue;
+    if (value < kHistogramSubBuckets)
+        return (int)value;
+
+    int shift = 0;
+    while ((value >> shift) >= 2 * kHistogramSubBuckets)
+        ++shift;
+    return (shift + 1) * kHistogramSubBuckets + (int)(value >> shift) - kHistogramSubBuckets;
+}
+
+// Largest value which goes to bucket
+uint64_t bucketUpperValue(int index) {
+    if (index < kHistogramSubBuckets)
+        return index;
+
+    int shift = index / kHistogramSubBuckets - 1;
+    uint64_t subBucket = index % kHistogramSubBuckets + kHistogramSubBuckets;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+// Adds value to histogram
+void recordValue(Histogram& histogram, uint64_t value) {
+    histogram.buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    histogram.count.fetch_add(1, std::memory_order_relaxed);
+    histogram.sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t max = histogram.max.load(std::memory_order_relaxed);
+    while (value > max && !histogram.max.compare_exchange_weak(max, value, std::memory_order_relaxed));
+}
+
+// Gets value at percentile (0..1). Returns upper bound of bucket, but not more than max
+uint64_t histogramPercentile(const Histogram& histogram, double rank) {
+    uint64_t count = histogram.count.load(std::memory_order_relaxed);
+    if (count == 0)
+        return 0;
+
+    uint64_t target = (uint64_t)(rank * count + 0.5), seen = 0;
+    if (target == 0)
+        target = 1;
+    uint64_t max = histogram.max.load(std::memory_order_relaxed);
+    for (int i = 0; i < kHistogramBuckets; ++i) {
+        seen += histogram.buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+            return (std::min)(bucketUpperValue(i), max);
+    }
+    return max;
+}
+
+// Adds handling time of request to its type histogram
+void recordRequest(char type, uint64_t latency) {
+    if (type >= 'A' && type <= 'Z')
+        recordValue(metrics.requests[type - 'A'], latency);
+}
+
+// Appends metric line "name value"
+void appendMetric(std::string& text, const std::string& name, uint64_t value) {
+    text += name + " " + std::to_string(value) + "\n";
+}
+
+// Appends histogram lines: count, mean, p50, p90, p99, p999, max
+void appendHistogram(std::string& text, const std::string& name, const Histogram& histogram) {
+    uint64_t count = histogram.count.load(std::memory_order_relaxed);
+    appendMetric(text, name + "_count", count);
+    if (count == 0)
+        return;
+
+    appendMetric(text, name + "_mean_us", histogram.sum.load(std::memory_order_relaxed) / count);
+    appendMetric(text, name + "_p50_us", histogramPercentile(histogram, 0.5));
+    appendMetric(text, name + "_p90_us", histogramPercentile(histogram, 0.9));
+    appendMetric(text, name + "_p99_us", histogramPercentile(histogram, 0.99));
+    appendMetric(text, name + "_p999_us", histogramPercentile(histogram, 0.999));
+    appendMetric(text, name + "_max_us", histogram.max.load(std::memory_order_relaxed));
+}
+
+// Formats counters and histograms of server metrics
+std::string formatMetrics(const ServerMetrics& serverMetrics) {
+    std::string text;
+    for (int i = 0; i < kRequestTypes; ++i)
+        if (serverMetrics.requests[i].count.load(std::memory_order_relaxed) != 0)
+            appendHistogram(text, std::string("request_") + char('A' + i), serverMetrics.requests[i]);
+    appendMetric(text, "failed_requests", serverMetrics.failedRequests);
+    appendMetric(text, "expired_users", serverMetrics.expiredUsers);
+    appendMetric(text, "expired_games", serverMetrics.expiredGames);
+    appendHistogram(text, "bot_move", serverMetrics.botMoves);
+
+    appendHistogram(text, "games_lock_wait", serverMetrics.gamesLock.wait);
+    appendHistogram(text, "games_lock_hold", serverMetrics.gamesLock.hold);
+    appendHistogram(text, "games_lock_shared_wait", serverMetrics.gamesLock.sharedWait);
+    appendHistogram(text, "users_lock_wait", serverMetrics.usersLock.wait);
+    appendHistogram(text, "users_lock_hold", serverMetrics.usersLock.hold);
+    appendHistogram(text, "users_lock_shared_wait", serverMetrics.usersLock.sharedWait);
+
+    appendMetric(text, "worker_busy_us", serverMetrics.workerBusyTime);
+    appendMetric(text, "worker_idle_us", serverMetrics.workerIdleTime);
+    int64_t queuedRequests = serverMetrics.queuedRequests;
+    appendMetric(text, "proxy_queue_depth", queuedRequests > 0 ? queuedRequests : 0);
+    return text;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Server metrics. Updated by workers with relaxed atomics, read by admin thread.
+// Latencies are in microseconds and kept in log-linear histograms: every power of two
+// is split into kHistogramSubBuckets buckets, so error of percentile is under 1/16.
+const int kHistogramSubBucketBits = 4;
+const int kHistogramSubBuckets = 1 << kHistogramSubBucketBits;
+const int kHistogramValueBits = 40; // Values up to ~12 days
+const int kHistogramBuckets = (kHistogramValueBits - kHistogramSubBucketBits + 1) * kHistogramSubBuckets;
+
+typedef struct structHistogram {
+    std::atomic<uint64_t> buckets[kHistogramBuckets];
+    std::atomic<uint64_t> count, sum, max;
+    structHistogram();
+} Histogram;
+
+// Wait and hold time of mutex. Acquire time is written only by thread holding mutex exclusively,
+// so only wait time is recorded for shared locks
+typedef struct structLockMetrics {
+    Histogram wait, hold, sharedWait;
+    uint64_t acquiredAt = 0;
+} LockMetrics;
+
+const int kRequestTypes = 26; // Request types are capital letters
+
+typedef struct structServerMetrics {
+    Histogram requests[kRequestTypes]; // Handling time per request type
+    std::atomic<uint64_t> failedRequests;
+    LockMetrics gamesLock, usersLock;
+    std::atomic<uint64_t> workerBusyTime, workerIdleTime;
+    std::atomic<int64_t> queuedRequests; // Forwarded by proxy, not taken by worker yet
+    std::atomic<uint64_t> expiredUsers, expiredGames; // Removed by reaper as idle
+    Histogram botMoves; // Time of choosing shot by bot
+    structServerMetrics();
+} ServerMetrics;
+
+inline ServerMetrics metrics;
+
+// Current time for metrics, microseconds
+uint64_t metricsClock();
+
+// Adds value to histogram
+void recordValue(Histogram& histogram, uint64_t value);
+
+// Gets value at percentile (0..1). Returns upper bound of bucket, but not more than max
+uint64_t histogramPercentile(const Histogram& histogram, double rank);
+
+// Adds handling time of request to its type histogram
+void recordRequest(char type, uint64_t latency);
+
+// Appends metric line "name value"
+void appendMetric(std::string& text, const std::string& name, uint64_t value);
+
+// Appends histogram lines: count, mean, p50, p90, p99, p999, max
+void appendHistogram(std::string& text, const std::string& name, const Histogram& histogram);
+
+// Formats counters and histograms of server metrics
+std::string formatMetrics(const ServerMetrics& serverMetrics);
@@ -0,0 +1,250 @@
+#include <charconv>
+#include <cstring>
+
+#include "Protocol.h"
+#include "MessageTokenizer.h"
+#include "BinaryProtocol.h"
+#include "ServerConnection.h"
+
+structRequest::structRequest() {
+    type = kNothing;
+    isBinary = false;
+    uniqueID = 0;
+    gameID = 0;
+    row = column = -1;
+    timeout = 0;
+    cursor = limit = 0;
+    version = 0;
+}
+
+structRespond::structRespond(char respondType) {
+    type = respondType;
+    result = 0;
+    uniqueID = 0;
+    gameID = 0;
+}
+
+// Parse unsigned number. Returns 0 if string is not a number
+uint64_t parseNumber(std::string_view number) {
+    uint64_t result = 0;
+    auto parsed = std::from_chars(number.data(), number.data() + number.size(), result);
+    if (parsed.ec != std::errc() || parsed.ptr != number.data() + number.size())
+        return 0;
+    return result;
+}
+
+// Check if login or game name can be put into messages: not empty, only printable symbols without delimiters
+bool correctName(std::string_view name) {
+    if (name.empty())
+        return false;
+    for (char symbol : name)
+        if (symbol < ' ' || symbol > '~' || symbol == kMessagePartsDelimiter || symbol == kMessageDelimiter)
+            return false;
+    return true;
+}
+
+// Decode request in text protocol
+bool decodeTextRequest(std::string_view message, Request& request) {
+    // Delivered message has own delimiters, so it is not split
+    if (message[0] == kDeliverMessage) {
+        request.type = kDeliverMessage;
+        takeMessagePart(message, kMessagePartsDelimiter);
+        request.uniqueID = parseNumber(takeMessagePart(message, kMessagePartsDelimiter));
+        request.message = message;
+        return request.uniqueID != 0 && !request.message.empty();
+    }
+
+    MessageParts parts;
+    bool isSplit = splitMessage(message, kMessagePartsDelimiter, parts);
+    std::string_view* messageParts = parts.part;
+    request.type = messageParts[0].empty() ? kNothing : messageParts[0][0];
+    request.isBinary = false;
+
+    if (!isSplit)
+        return false;
+
+    if (request.type == kLogin) {
+        if (parts.size != 2)
+            return false;
+        request.login = messageParts[1];
+        return correctName(request.login);
+    }
+
+    if (parts.size > 1)
+        request.uniqueID = parseNumber(messageParts[1]);
+
+    switch (request.type) {
+    case kCreateGame:
+    case kJoinGame:
+    case kPlayBot:
+        if (parts.size != 3)
+            return false;
+        request.gameName = messageParts[2];
+        return correctName(request.gameName);
+    case kInvitePlayer:
+        if (parts.size != 4)
+            return false;
+        request.login = messageParts[2];
+        request.gameName = messageParts[3];
+        return correctName(request.login) && correctName(request.gameName);
+    case kFieldCheck:
+        if (parts.size != 13)
+            return false;
+        request.gameName = messageParts[2];
+        for (int row = 0; row < 10; ++row) {
+            if (messageParts[3 + row].size() != 10)
+                return false;
+
+            for (int column = 0; column < 10; ++column) {
+                int tile = mapSymbolToNumber(messageParts[3 + row][column]);
+                if (tile == -1)
+                    return false;
+                if (tile == kShip)
+                    request.field |= cellBoard(row, column);
+            }
+        }
+        return true;
+    case kDoAction:
+        if (parts.size != 4 || messageParts[3].size() != 2)
+            return false;
+        request.gameName = messageParts[2];
+        request.row = messageParts[3][0] - '0';
+        request.column = messageParts[3][1] - '0';
+        return true;
+    case kNothing:
+        if (parts.size > 2)
+            request.timeout = (int)parseNumber(messageParts[2]);
+        return true;
+    case kGetGameList:
+        if (parts.size == 4) {
+            request.cursor = (int)parseNumber(messageParts[2]);
+            request.limit = (int)parseNumber(messageParts[3]);
+        }
+        return parts.size == 2 || parts.size == 4;
+    case kGameListChanges:
+        if (parts.size != 3)
+            return false;
+        request.version = parseNumber(messageParts[2]);
+        return true;
+    case kRegisterUser:
+        if (parts.size != 3)
+            return false;
+        request.login = messageParts[2];
+        return request.uniqueID != 0 && !request.login.empty();
+    case kExpireUser:
+        return parts.size == 2 && request.uniqueID != 0;
+    default:
+        return true;
+    }
+}
+
+// Decode request in binary protocol
+bool decodeBinaryRequest(const unsigned char* frame, size_t size, Request& request) {
+    BinaryHeader header = readBinaryHeader(frame);
+    const unsigned char* payload = frame + kBinaryHeaderSize;
+    size_t payloadSize = size - kBinaryHeaderSize;
+
+    request.type = header.type;
+    request.isBinary = true;
+    request.uniqueID = header.uniqueID;
+    request.gameID = header.gameID;
+
+    switch (request.type) {
+    case kLogin:
+    case kInvitePlayer:
+        request.login = std::string_view(reinterpret_cast<const char*>(payload), payloadSize);
+        return correctName(request.login);
+    case kCreateGame:
+    case kPlayBot:
+        request.gameName = std::string_view(reinterpret_cast<const char*>(payload), payloadSize);
+        return correctName(request.gameName);
+    case kJoinGame:
+        // Only game which exists can be joined by ID without name
+        request.gameName = std::string_view(reinterpret_cast<const char*>(payload), payloadSize);
+        return request.gameName.empty() ? request.gameID != 0 : correctName(request.gameName);
+    case kFieldCheck:
+        if (payloadSize != kFieldBitmapSize)
+            return false;
+        for (int row = 0; row < 10; ++row)
+            for (int column = 0; column < 10; ++column)
+                if (getFieldBit(payload, row, column))
+                    request.field |= cellBoard(row, column);
+        return true;
+    case kDoAction:
+        if (payloadSize != kMoveSize)
+            return false;
+        request.row = payload[0];
+        request.column = payload[1];
+        return true;
+    case kNothing:
+        if (payloadSize == kPollTimeoutSize) {
+            uint32_t timeout;
+            std::memcpy(&timeout, payload, kPollTimeoutSize);
+            request.timeout = (int)timeout;
+        }
+        return true;
+    case kGetGameList:
+        if (payloadSize == kGameListPageSize) {
+            uint32_t page[2];
+            std::memcpy(page, payload, kGameListPageSize);
+            request.cursor = (int)page[0];
+            request.limit = (int)page[1];
+        }
+        return payloadSize == 0 || payloadSize == kGameListPageSize;
+    case kGameListChanges:
+        if (payloadSize != kGameListVersionSize)
+            return false;
+        std::memcpy(&request.version, payload, kGameListVersionSize);
+        return true;
+    case kRegisterUser:
+    case kDeliverMessage:
+    case kExpireUser:
+        // Shards and router send internal requests only in text protocol
+        return false;
+    default:
+        return true;
+    }
+}
+
+// Decode request in text or binary protocol. Returns false if request is malformed
+bool decodeRequest(const zmq::message_t& message, Request& request) {
+    const unsigned char* frame = static_cast<const unsigned char*>(message.data());
+    if (isBinaryFrame(frame, message.size()))
+        return decodeBinaryRequest(frame, message.size(), request);
+    if (message.size() == 0)
+        return false;
+    return decodeTextRequest(message.to_string_view(), request);
+}
+
+// Encode respond in text or binary protocol
+std::string encodeRespond(const Respond& respond, bool isBinary) {
+    if (isBinary) {
+        std::string frame(kBinaryHeaderSize, '\0');
+        fillBinaryHeader(&frame[0], respond.type, respond.uniqueID, respond.gameID, respond.result);
+        return frame + respond.payload;
+    }
+
+    std::string message(1, respond.type);
+    switch (respond.type) {
+    case kLogin:
+    case kRegisterUser:
+        message += std::string(1, kMessagePartsDelimiter) + std::to_string(respond.uniqueID);
+        break;
+    case kCreateGame:
+    case kJoinGame:
+    case kPlayBot:
+        message += std::string(1, kMessagePartsDelimiter) + std::to_string(respond.gameID);
+        break;
+    case kDoAction:
+        message += std::string(1, kMessagePartsDelimiter) + std::string(1, respond.result + '0');
+        break;
+    case kFailure:
+        if (respond.result != 0)
+            message += std::string(1, kMessagePartsDelimiter) + std::to_string(respond.result);
+        break;
+    default:
+        message += respond.payload;
+        break;
+    }
+    return message;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <zmq.hpp>
+
+#include "Rules.h"
+
+// Decoded request of client. Same for text and binary protocols.
+// Login and game name are views into received message, so request lives while message lives
+typedef struct structRequest {
+    char type;
+    bool isBinary;
+    uint64_t uniqueID;
+    int gameID; // 0 - game is set by name
+    std::string_view login, gameName;
+    int row, column;
+    Board field;
+    int timeout; // How long poll can wait for messages, ms
+    int cursor, limit; // Page of game list, limit 0 - whole list
+    uint64_t version; // Version of game list known by client
+    std::string_view message; // Message for user of other shard
+    structRequest();
+} Request;
+
+// Respond for client. Encoded in protocol of request
+typedef struct structRespond {
+    char type;
+    int result;          // Result of move
+    uint64_t uniqueID;   // UID of new user
+    int gameID;          // ID of created or joined game
+    std::string payload; // Game list: #Version#NextCursor#Game1#Game2..., changes: #Version#+Game1#-Game2...
+    structRespond(char respondType);
+} Respond;
+
+// Parse unsigned number. Returns 0 if string is not a number
+uint64_t parseNumber(std::string_view number);
+
+// Decode request in text or binary protocol. Returns false if request is malformed
+bool decodeRequest(const zmq::message_t& message, Request& request);
+
+// Encode respond in text or binary protocol
+std::string encodeRespond(const Respond& respond, bool isBinary);
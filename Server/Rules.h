@@ -0,0 +1,269 @@
+#pragma once
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <cstring>
+
+#include "ServerConnection.h"
+
+// Rules of game shared by server, client and simulator. Header only, so every program is built with
+// the same rules. Nothing here allocates: fields are fixed-size bitboards and tile arrays.
+//
+// Game field is stored as bitboard. Cells are stored row by row with one extra empty column,
+// so shifts by one cell never wrap to the next row
+const int kFieldSize = 10;
+const int kBoardStride = kFieldSize + 1;
+const int kBoardBits = kFieldSize * kBoardStride;
+
+typedef std::bitset<kBoardBits> Board;
+
+// Ships touching by side or corner are one ship, so field can't have more ships than this
+const int kMaxShips = kFieldSize * kFieldSize / 4;
+
+// Fleet: 4, 3, 3, 2, 2, 2, 1, 1, 1, 1 straight ships which don't touch each other
+const int kMaxShipSize = 4;
+constexpr int kFleetShips[kMaxShipSize + 1] = { 0, 4, 3, 2, 1 }; // Number of ships of every size
+
+// Number of cells of all ships of fleet
+constexpr int kFleetCells = [] {
+    int cells = 0;
+    for (int size = 1; size <= kMaxShipSize; ++size)
+        cells += size * kFleetShips[size];
+    return cells;
+}();
+
+// Symbols of tiles on screen: kSea, kShip, kDamagedShip, kDamagedSea, kUnknownTile
+constexpr char kTileSymbols[] = { ' ', '@', '*', '.', '?' };
+
+// Tile of every symbol of field sent by player, -1 - wrong symbol
+constexpr std::array<int8_t, 256> kSymbolTiles = [] {
+    std::array<int8_t, 256> tiles = {};
+    for (int8_t& tile : tiles)
+        tile = -1;
+    tiles['.'] = kSea;
+    tiles['@'] = kShip;
+    return tiles;
+}();
+
+// Check if coordinate is correct
+constexpr bool correctCoordinate(int number) {
+    return number >= 0 && number < kFieldSize;
+}
+
+// Convert char field symbols to int analog
+constexpr int mapSymbolToNumber(char symbol) {
+    return kSymbolTiles[(unsigned char)symbol];
+}
+
+// Convert int analog to char field symbols
+constexpr char numberToMapSymbol(int number) {
+    return number >= 0 && number < (int)sizeof(kTileSymbols) ? kTileSymbols[number] : '!';
+}
+
+// ===========================================================================================
+//
+//                                      Bitboards
+//
+// ===========================================================================================
+
+// Gets bitboard with all cells of field
+inline const Board& boardCells() {
+    static const Board cells = [] {
+        Board board;
+        for (int row = 0; row < kFieldSize; ++row)
+            for (int column = 0; column < kFieldSize; ++column)
+                board.set(row * kBoardStride + column);
+        return board;
+    }();
+    return cells;
+}
+
+// Gets bitboard with one cell
+inline Board cellBoard(int row, int column) {
+    Board board;
+    board.set(row * kBoardStride + column);
+    return board;
+}
+
+// Gets cells of board and all cells around them (including diagonal ones)
+inline Board neighbourCells(const Board& board) {
+    Board result = board | (board << 1) | (board >> 1);
+    result |= (result << kBoardStride) | (result >> kBoardStride);
+    return result & boardCells();
+}
+
+// Gets cells of board and cells next to them by side
+inline Board sideNeighbourCells(const Board& board) {
+    Board result = board | (board << 1) | (board >> 1) | (board << kBoardStride) | (board >> kBoardStride);
+    return result & boardCells();
+}
+
+// Gets all ship cells connected with cell. Uses bitwise flood fill
+inline Board shipCells(const Board& ships, int row, int column) {
+    Board ship = cellBoard(row, column) & ships, previous;
+    while (ship != previous) {
+        previous = ship;
+        ship = neighbourCells(ship) & ships;
+    }
+    return ship;
+}
+
+// Gets ship cells connected with cell only by sides
+inline Board shipSideCells(const Board& ships, int cell) {
+    Board ship, previous;
+    ship.set(cell);
+    while (ship != previous) {
+        previous = ship;
+        ship = sideNeighbourCells(ship) & ships;
+    }
+    return ship;
+}
+
+// Gets straight line of cells from cell to the right or down
+inline Board lineCells(int cell, int length, int step) {
+    Board line;
+    for (int i = 0; i < length && cell + i * step < kBoardBits; ++i)
+        line.set(cell + i * step);
+    return line;
+}
+
+// Checks fleet rules. Returns 0 if fleet is correct, otherwise code of wrong field
+inline int checkFleet(const Board& ships) {
+    int shipsOfSize[kMaxShipSize + 1] = {};
+
+    // Every pass takes one group of ships touching by side or corner
+    Board left = ships & boardCells();
+    for (int cell = 0; cell < kBoardBits && left.any(); ++cell) {
+        if (!left.test(cell))
+            continue;
+
+        Board ship = shipCells(left, cell / kBoardStride, cell % kBoardStride);
+        left &= ~ship;
+
+        if (shipSideCells(ship, cell) != ship)
+            return kFieldShipsTouch;
+
+        // First cell of group is its top left cell, so straight ship goes right or down from it
+        int size = (int)ship.count();
+        if (size > kMaxShipSize)
+            return kFieldWrongFleet;
+        if (ship != lineCells(cell, size, 1) && ship != lineCells(cell, size, kBoardStride))
+            return kFieldWrongShape;
+        ++shipsOfSize[size];
+    }
+
+    for (int size = 1; size <= kMaxShipSize; ++size)
+        if (shipsOfSize[size] != kFleetShips[size])
+            return kFieldWrongFleet;
+    return 0;
+}
+
+// Gives every ship ID from 1. Fills ship ID of every cell (row * kFieldSize + column, 0 - sea)
+// and size of every ship. Returns number of ships
+inline int labelShips(const Board& ships, uint8_t labels[kFieldSize * kFieldSize], uint8_t sizes[kMaxShips + 1]) {
+    int shipCount = 0;
+    for (int cell = 0; cell < kFieldSize * kFieldSize; ++cell)
+        labels[cell] = 0;
+
+    for (int row = 0; row < kFieldSize; ++row)
+        for (int column = 0; column < kFieldSize; ++column) {
+            if (!ships.test(row * kBoardStride + column) || labels[row * kFieldSize + column] != 0)
+                continue;
+
+            Board ship = shipCells(ships, row, column);
+            sizes[++shipCount] = (uint8_t)ship.count();
+            for (int shipRow = row; shipRow < kFieldSize; ++shipRow)
+                for (int shipColumn = 0; shipColumn < kFieldSize; ++shipColumn)
+                    if (ship.test(shipRow * kBoardStride + shipColumn))
+                        labels[shipRow * kFieldSize + shipColumn] = shipCount;
+        }
+    return shipCount;
+}
+
+// ===========================================================================================
+//
+//                                    Player field
+//
+// ===========================================================================================
+
+// Field of one player in game: his ships and shots at them. Ships are labeled when field is placed,
+// so shot is resolved by counters without scanning field. Used by server games and by simulator
+typedef struct structPlayerField {
+    Board ships, hits, misses; // Ships, damaged ships and damaged sea
+    Board sunk; // Cells of destroyed ships
+    uint8_t shipLabels[kFieldSize * kFieldSize]; // Ship ID of every cell, 0 - sea
+    uint8_t shipCellsLeft[kMaxShips + 1]; // Not damaged cells of every ship
+    int aliveCells; // Not damaged ship cells
+    structPlayerField();
+} PlayerField;
+
+inline structPlayerField::structPlayerField() {
+    std::memset(shipLabels, 0, sizeof(shipLabels));
+    std::memset(shipCellsLeft, 0, sizeof(shipCellsLeft));
+    aliveCells = 0;
+}
+
+// Sets ships of field and labels them
+inline void placeFleet(PlayerField& field, const Board& ships) {
+    field.ships = ships;
+    labelShips(ships, field.shipLabels, field.shipCellsLeft);
+    field.aliveCells = (int)ships.count();
+}
+
+// Makes shot at field. Returns kDamagedSea, kDamagedShip or kDestroyed.
+// Shot at the same cell again changes nothing
+inline int shootAt(PlayerField& field, int row, int column) {
+    Board cell = cellBoard(row, column);
+    if ((field.hits & cell).any())
+        return kDamagedShip;
+    if ((field.misses & cell).any())
+        return kDamagedSea;
+
+    if (int ship = field.shipLabels[row * kFieldSize + column]) {
+        field.hits |= cell;
+        --field.aliveCells;
+        if (--field.shipCellsLeft[ship] != 0)
+            return kDamagedShip;
+        field.sunk |= shipCells(field.ships, row, column);
+        return kDestroyed;
+    }
+
+    field.misses |= cell;
+    return kDamagedSea;
+}
+
+// ===========================================================================================
+//
+//                                     Tile fields
+//
+// ===========================================================================================
+
+// Field as player sees it: tile of every cell
+typedef int Tiles[kFieldSize][kFieldSize];
+
+// Marks destroyed ship: its cells are damaged ship, cells around it are damaged sea.
+// Flood fill keeps cells to visit in fixed-size stack, every cell is put there once
+inline void markDestroyedShip(Tiles& tiles, int row, int column) {
+    bool isVisited[kFieldSize][kFieldSize] = {};
+    int stack[kFieldSize * kFieldSize], size = 0;
+    tiles[row][column] = kDamagedShip;
+    isVisited[row][column] = true;
+    stack[size++] = row * kFieldSize + column;
+
+    while (size > 0) {
+        int cell = stack[--size];
+        for (int tileRow = cell / kFieldSize - 1; tileRow <= cell / kFieldSize + 1; ++tileRow)
+            for (int tileColumn = cell % kFieldSize - 1; tileColumn <= cell % kFieldSize + 1; ++tileColumn) {
+                if (!correctCoordinate(tileRow) || !correctCoordinate(tileColumn) || isVisited[tileRow][tileColumn])
+                    continue;
+
+                int& tile = tiles[tileRow][tileColumn];
+                if (tile == kDamagedShip) {
+                    isVisited[tileRow][tileColumn] = true;
+                    stack[size++] = tileRow * kFieldSize + tileColumn;
+                }
+                else if (tile == kSea || tile == kUnknownTile)
+                    tile = kDamagedSea;
+            }
+    }
+}
@@ -1,36 +1,167 @@
 #include <zmq.hpp>
 #include <string>
 #include <iostream>
-#include <Windows.h>
 #include <random>
 #include <vector>
 #include <queue>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <memory>
 
 #include "ServerConnection.h"
+#include "BinaryProtocol.h"
+#include "Protocol.h"
+#include "MessageTokenizer.h"
 #include "Games.h"
 #include "Users.h"
+#include "Metrics.h"
+#include "Journal.h"
+#include "Sharding.h"
+#include "Config.h"
+#include "Logger.h"
+#include "Expiry.h"
+#include "Bot.h"
+
+// Users and games mutexes are taken shared for lookups and exclusive for changes
+std::shared_mutex usersMutex; // Mutex for users list and indexes. Messages are added to users mailboxes without it
+std::mutex parkedPollsMutex; // Mutex for parked polls and notified users
+std::shared_mutex gamesMutex; // Mutex for games list and indexes. Every game has own mutex in gameMutexes
+ServerConfig config; // Read at start, not changed later
+
+// Locks mutex exclusively and records wait time
+void lockMutex(std::shared_mutex& mutex, LockMetrics& lockMetrics) {
+    uint64_t start = metricsClock();
+    mutex.lock();
+    lockMetrics.acquiredAt = metricsClock();
+    recordValue(lockMetrics.wait, lockMetrics.acquiredAt - start);
+}
+
+// Records hold time and unlocks exclusive mutex
+void unlockMutex(std::shared_mutex& mutex, LockMetrics& lockMetrics) {
+    recordValue(lockMetrics.hold, metricsClock() - lockMetrics.acquiredAt);
+    mutex.unlock();
+}
 
-HANDLE hUsersMutex; // Mutex for users
-HANDLE hGamesMutex; // Mutex for games
-const int kMaxThreads = 8; // Max workers thread count
-const char kWorkersPort[] = "inproc://workers"; // Port for workers
+// Locks mutex for reading and records wait time. Readers don't block each other
+void lockMutexShared(std::shared_mutex& mutex, LockMetrics& lockMetrics) {
+    uint64_t start = metricsClock();
+    mutex.lock_shared();
+    recordValue(lockMetrics.sharedWait, metricsClock() - start);
+}
 
-// Split string with delimiter
-std::vector<std::string> splitString(std::string request, std::string delimiter) {
-    std::vector<std::string> messages;
-    if (request.find(delimiter) != std::string::npos) {
-        int position = request.find(delimiter);
-        do {
-            messages.push_back(request.substr(0, position));
-            request = request.substr(position + 1, request.length() - position);
-            position = request.find(delimiter);
-        } while (position != std::string::npos);
-        messages.push_back(request);
+// Finds game of request by ID or name and locks its mutex. Returns nullptr if there is no such game.
+// Games mutex is never held while waiting for game mutex, so moves in different games run in parallel.
+Game* lockGame(const Request& request, std::mutex*& gameMutex) {
+    lockMutexShared(gamesMutex, metrics.gamesLock);
+    int gameNumber;
+    if (request.gameID != 0)
+        gameNumber = searchGameByID(request.gameID);
+    else
+        gameNumber = searchGameByName(request.gameName);
+
+    if (gameNumber == -1) {
+        gamesMutex.unlock_shared();
+        return nullptr;
     }
-    else {
-        messages.push_back(request);
+
+    Game* game = &games[gameNumber];
+    int gameID = game->id;
+    gameMutex = &gameMutexes[gameNumber];
+    gamesMutex.unlock_shared();
+
+    // Game could be removed while we were waiting for it
+    gameMutex->lock();
+    if (game->id != gameID) {
+        gameMutex->unlock();
+        return nullptr;
     }
-    return messages;
+    return game;
+}
+
+// Users whose parked polls got messages. Workers respond to them
+std::vector<User*> notifiedUsers;
+
+// Removal epoch + 1 seen by every worker at start of its request, 0 - worker is idle.
+// Worker can hold pointer to removed user only if its request started before removal
+std::unique_ptr<std::atomic<uint64_t>[]> workerEpochs;
+
+// Messages for users of other shards: shard -> deliver request. Workers send them to shards
+std::mutex remoteMessagesMutex;
+std::vector<std::pair<int, std::string>> remoteMessages;
+
+// Finds user by UID. Returns nullptr if there is no such user
+User* findUser(uint64_t uniqueID) {
+    lockMutexShared(usersMutex, metrics.usersLock);
+    User* user = getUserByUID(uniqueID);
+    usersMutex.unlock_shared();
+    return user;
+}
+
+// Adds message to user's mailbox and marks his parked poll to wake.
+// Message for user of other shard is sent to his shard
+void sendMessageToUser(User* user, const std::string& message) {
+    if (user == nullptr)
+        return;
+
+    int userShard = shardOfUser(user->uniqueID);
+    if (userShard != shardNumber) {
+        std::string request = std::string(1, kDeliverMessage) + std::string(1, kMessagePartsDelimiter)
+            + std::to_string(user->uniqueID) + std::string(1, kMessagePartsDelimiter) + message;
+        remoteMessagesMutex.lock();
+        remoteMessages.emplace_back(userShard, std::move(request));
+        remoteMessagesMutex.unlock();
+        return;
+    }
+
+    if (!addMessageToUser(*user, message))
+        return;
+
+    parkedPollsMutex.lock();
+    notifiedUsers.push_back(user);
+    parkedPollsMutex.unlock();
+}
+
+// Adds message of bot's move for player. His poll isn't woken, so moves go with respond to his move
+// in order they were made. Player of other shard gets them through his shard
+void sendBotMessage(User* player, const std::string& message) {
+    if (player == nullptr)
+        return;
+
+    if (shardOfUser(player->uniqueID) != shardNumber)
+        sendMessageToUser(player, message);
+    else
+        addMessageToUser(*player, message);
+}
+
+// Bot shoots at player's field until it misses or wins. Called with game mutex taken. Returns true if bot won
+bool playBotMoves(Game& game, User* player) {
+    int result;
+    do {
+        uint64_t start = metricsClock();
+        int cell = chooseBotShot(game.fields[0].hits, game.fields[0].misses, game.fields[0].sunk);
+        recordValue(metrics.botMoves, metricsClock() - start);
+
+        int row = cell / kFieldSize, column = cell % kFieldSize;
+        result = shootAt(game.fields[0], row, column);
+        journalShot(game.id, 0, row, column);
+
+        std::string message = std::string(1, kEnemyAction) + std::string(1, kMessagePartsDelimiter)
+            + std::string(1, row + '0') + std::string(1, column + '0') + std::string(1, result + '0');
+        sendBotMessage(player, message);
+    } while (result != kDamagedSea && game.fields[0].aliveCells != 0);
+    game.lastActivity[1] = tickCount();
+
+    if (game.fields[0].aliveCells != 0)
+        return false;
+
+    sendBotMessage(player, std::string(1, kGameEnd) + std::string(1, kMessagePartsDelimiter) + kBotLogin);
+    return true;
 }
 
 // ===========================================================================================
@@ -40,281 +171,498 @@ std::vector<std::string> splitString(std::string request, std::string delimiter)
 // ===========================================================================================
 
 // Login request handler
-std::string userLoginHandler(const std::vector<std::string>& message) {
-    std::string login = message[1];
-    std::string respond;
-    WaitForSingleObject(hUsersMutex, INFINITE);
-
-    if (!uniqueUserLogin(login)) {
-        respond = std::string(1, kFailure);
-        ReleaseMutex(hUsersMutex);
-        return respond;
+Respond userLoginHandler(const Request& request) {
+    lockMutex(usersMutex, metrics.usersLock);
+
+    if (!uniqueUserLogin(request.login)) {
+        unlockMutex(usersMutex, metrics.usersLock);
+        return Respond(kFailure);
     }
 
-    User newUser = User(login);
-    users.push_back(newUser);
-    ReleaseMutex(hUsersMutex);
+    int userNumber = addUser(std::string(request.login));
+    if (userNumber == -1) {
+        unlockMutex(usersMutex, metrics.usersLock);
+        return Respond(kFailure);
+    }
+
+    Respond respond(kLogin);
+    respond.uniqueID = users[userNumber].uniqueID;
+    journalUserAdded(respond.uniqueID, request.login);
+    unlockMutex(usersMutex, metrics.usersLock);
 
-    respond = std::string(1, kLogin) + std::string(1, kMessagePartsDelimiter) + newUser.uniqueID;
     return respond;
 }
 
 // Create game request handler
-std::string createGameHandler(const std::vector<std::string>& message) {
-    std::string gameName = message[2];
-    WaitForSingleObject(hGamesMutex, INFINITE);
+Respond createGameHandler(const Request& request) {
+    lockMutex(gamesMutex, metrics.gamesLock);
 
-    if (!uniqueGameName(gameName)) {
-        ReleaseMutex(hGamesMutex);
-        return std::string(1, kFailure);
+    if (!uniqueGameName(request.gameName)) {
+        unlockMutex(gamesMutex, metrics.gamesLock);
+        return Respond(kFailure);
     }
 
-    std::string uniqueID = message[1];
-    Game newGame = Game(gameName, uniqueID);
-    games.push_back(newGame);
-    ReleaseMutex(hGamesMutex);
+    Respond respond(kCreateGame);
+    respond.gameID = games[addGame(std::string(request.gameName), request.uniqueID)].id;
+    journalGameCreated(respond.gameID, request.uniqueID, request.gameName);
+    unlockMutex(gamesMutex, metrics.gamesLock);
 
-    WaitForSingleObject(hUsersMutex, INFINITE);
-    int playerNumber = searchUserByUID(uniqueID);
-    users[playerNumber].gameName = gameName;
-    ReleaseMutex(hUsersMutex);
+    lockMutex(usersMutex, metrics.usersLock);
+    User* player = getUserByUID(request.uniqueID);
+    if (player != nullptr)
+        player->gameName = request.gameName;
+    unlockMutex(usersMutex, metrics.usersLock);
 
-    return std::string(1, kCreateGame);
+    return respond;
 }
 
-// Get game list request handler
-std::string getGameListHandler(const std::vector<std::string>& message) {
-    std::string respond = std::string(1, kGetGameList);
-    WaitForSingleObject(hGamesMutex, INFINITE);
+// Game with bot request handler. Bot joins and places field at once, so game starts when player places his one
+Respond playBotHandler(const Request& request) {
+    lockMutex(gamesMutex, metrics.gamesLock);
 
-    for (int i = 0; i < games.size(); ++i) 
-        if (games[i].player[1].empty())
-            respond += std::string(1, kMessagePartsDelimiter) + games[i].name;
+    if (!uniqueGameName(request.gameName)) {
+        unlockMutex(gamesMutex, metrics.gamesLock);
+        return Respond(kFailure);
+    }
+
+    int gameNumber = addGame(std::string(request.gameName), request.uniqueID);
+    Game& game = games[gameNumber];
+    joinSecondPlayer(gameNumber, kBotUID);
+    Board fleet = randomFleet();
+    submitField(game, 1, fleet);
+
+    Respond respond(kPlayBot);
+    respond.gameID = game.id;
+    journalGameCreated(game.id, request.uniqueID, request.gameName);
+    journalGameJoined(game.id, kBotUID);
+    journalFieldPlaced(game.id, 1, fleet);
+    unlockMutex(gamesMutex, metrics.gamesLock);
+
+    lockMutex(usersMutex, metrics.usersLock);
+    User* player = getUserByUID(request.uniqueID);
+    if (player != nullptr)
+        player->gameName = request.gameName;
+    unlockMutex(usersMutex, metrics.usersLock);
 
-    ReleaseMutex(hGamesMutex);
     return respond;
 }
 
-// Join game request handler
-std::string joinGameHandler(const std::vector<std::string>& message) {
-    WaitForSingleObject(hGamesMutex, INFINITE);
-    int gameNumber = searchGameByName(message[2]);
+// Get game list request handler. Without limit whole cached list is sent, otherwise one page after cursor
+Respond getGameListHandler(const Request& request) {
+    Respond respond(kGetGameList);
+    std::string gameList;
+    int nextCursor = 0;
+    lockMutexShared(gamesMutex, metrics.gamesLock);
 
-    if (gameNumber == -1) {
-        ReleaseMutex(hGamesMutex);
-        return std::string(1, kFailure);
-    }
-
-    if (!games[gameNumber].player[0].empty() && !games[gameNumber].player[1].empty()) {
-        ReleaseMutex(hGamesMutex);
-        return std::string(1, kFailure);
-    }
+    uint64_t version = gameListVersion;
+    if (request.limit == 0)
+        gameList = openGamesList();
+    else
+        nextCursor = appendOpenGames(gameList, request.cursor, (std::min)(request.limit, kMaxGameListPage));
 
-    games[gameNumber].player[1] = message[1];
-    WaitForSingleObject(hUsersMutex, INFINITE);
-    int waitingPlayerNumber = searchUserByUID(games[gameNumber].player[0]);
-    ReleaseMutex(hGamesMutex);
+    gamesMutex.unlock_shared();
 
-    int joinedUserNumber = searchUserByUID(message[1]);
-    users[joinedUserNumber].gameName = message[2];
+    respond.payload = std::string(1, kMessagePartsDelimiter) + std::to_string(version)
+        + std::string(1, kMessagePartsDelimiter) + std::to_string(nextCursor) + gameList;
+    return respond;
+}
 
-    std::string additionalMessage = std::string(1, kPlayerJoinYourGame) + std::string(1, kMessagePartsDelimiter)
-        + users[joinedUserNumber].login;
-    addMessageToUser(waitingPlayerNumber, additionalMessage);
+// Get game list changes request handler. Fails if client's version is too old, then client reloads list
+Respond gameListChangesHandler(const Request& request) {
+    Respond respond(kGameListChanges);
+    std::string changes;
+    lockMutexShared(gamesMutex, metrics.gamesLock);
+    uint64_t version = gameListVersion;
+    bool isKnown = appendGameListChanges(changes, request.version);
+    gamesMutex.unlock_shared();
 
-    ReleaseMutex(hUsersMutex);
+    if (!isKnown)
+        return Respond(kFailure);
 
-    return std::string(1, kJoinGame);
+    respond.payload = std::string(1, kMessagePartsDelimiter) + std::to_string(version) + changes;
+    return respond;
 }
 
-// Invite player request handler
-std::string invitePlayerHandler(const std::vector<std::string>& message) {
-    WaitForSingleObject(hUsersMutex, INFINITE);
-    int joinUserNumber = searchUserByLogin(message[2]);
+// Join game request handler
+Respond joinGameHandler(const Request& request) {
+    std::mutex* gameMutex;
+    Game* game = lockGame(request, gameMutex);
+
+    if (game == nullptr)
+        return Respond(kFailure);
 
-    if (joinUserNumber == -1) {
-        ReleaseMutex(hUsersMutex);
-        return std::string(1, kFailure);
+    if (game->player[0] != 0 && game->player[1] != 0) {
+        gameMutex->unlock();
+        return Respond(kFailure);
     }
 
-    int inviterUserNumber = searchUserByUID(message[1]);
-    std::string additionalMessage = std::string(1, kInvitePlayer) + std::string(1, kMessagePartsDelimiter)
-        + users[inviterUserNumber].login + std::string(1, kMessagePartsDelimiter) + message[3];
-    addMessageToUser(joinUserNumber, additionalMessage);
-    ReleaseMutex(hUsersMutex);
+    // Open games list is changed under games mutex
+    lockMutex(gamesMutex, metrics.gamesLock);
+    joinSecondPlayer(searchGameByID(game->id), request.uniqueID);
+    journalGameJoined(game->id, request.uniqueID);
+    unlockMutex(gamesMutex, metrics.gamesLock);
+
+    uint64_t waitingPlayerUID = game->player[0];
+    std::string gameName = game->name;
+    Respond respond(kJoinGame);
+    respond.gameID = game->id;
+    gameMutex->unlock();
+
+    lockMutex(usersMutex, metrics.usersLock);
+    User* waitingPlayer = getUserByUID(waitingPlayerUID);
+    User* joinedUser = getUserByUID(request.uniqueID);
+    if (joinedUser != nullptr)
+        joinedUser->gameName = gameName;
+    unlockMutex(usersMutex, metrics.usersLock);
+
+    if (joinedUser != nullptr) {
+        std::string additionalMessage = std::string(1, kPlayerJoinYourGame) + std::string(1, kMessagePartsDelimiter)
+            + joinedUser->login;
+        sendMessageToUser(waitingPlayer, additionalMessage);
+    }
 
-    return std::string(1, kJoinGame);
+    return respond;
 }
 
-// Convert char field symbols to int analog
-int mapSymbolToNumber(char symbol) {
-    switch (symbol) {
-    case '.': return 0;
-    case '@': return 1;
-    default: return -1;
+// Invite player request handler
+Respond invitePlayerHandler(const Request& request) {
+    // Binary requests set game by ID
+    std::string gameName(request.gameName);
+    if (request.gameID != 0) {
+        lockMutexShared(gamesMutex, metrics.gamesLock);
+        int gameNumber = searchGameByID(request.gameID);
+        if (gameNumber != -1)
+            gameName = games[gameNumber].name;
+        gamesMutex.unlock_shared();
     }
-}
 
-// Game field request handler
-std::string fieldCheckHandler(const std::vector<std::string>& message) {
-    if (message.size() != 13) 
-        return std::string(1, kFailure);
+    lockMutexShared(usersMutex, metrics.usersLock);
+    int joinUserNumber = searchUserByLogin(request.login);
+    User* joinUser = joinUserNumber == -1 ? nullptr : &users[joinUserNumber];
+    User* inviterUser = getUserByUID(request.uniqueID);
+    usersMutex.unlock_shared();
 
-    std::vector<std::vector<int>> map(10, std::vector<int>(10));
-    for (int row = 0; row < 10; ++row) {
-        if (message[3 + row].size() != 10) {
-            return std::string(1, kFailure);
-        }
+    if (joinUser == nullptr || inviterUser == nullptr || gameName.empty())
+        return Respond(kFailure);
 
-        for (int column = 0; column < 10; ++column) {
-            map[row][column] = mapSymbolToNumber(message[3 + row][column]);
-            if (map[row][column] == -1) 
-                return std::string(1, kFailure);
-        }
+    std::string additionalMessage = std::string(1, kInvitePlayer) + std::string(1, kMessagePartsDelimiter)
+        + inviterUser->login + std::string(1, kMessagePartsDelimiter) + gameName;
+    sendMessageToUser(joinUser, additionalMessage);
+
+    return Respond(kJoinGame);
+}
+
+// Game field request handler. Symbols are checked while decoding request, fleet rules are checked here
+Respond fieldCheckHandler(const Request& request) {
+    int fieldError = checkFleet(request.field);
+    if (fieldError != 0) {
+        Respond respond(kFailure);
+        respond.result = fieldError;
+        return respond;
     }
 
-    // Field is correct
-    WaitForSingleObject(hGamesMutex, INFINITE);
-    int gameNumber = searchGameByName(message[2]);
+    std::mutex* gameMutex;
+    Game* game = lockGame(request, gameMutex);
 
-    int columnOffset; 
-    if (message[1] == games[gameNumber].player[0]) 
-        columnOffset = 0; 
-    else 
-        columnOffset = 10;
+    if (game == nullptr)
+        return Respond(kFailure);
 
-    for (int row = 0; row < 10; ++row) 
-        for (int column = 0; column < 10; ++column) 
-            games[gameNumber].field[row][columnOffset + column] = map[row][column];
+    int playerNumber = searchPlayer(*game, request.uniqueID);
+    if (playerNumber == -1) {
+        gameMutex->unlock();
+        return Respond(kFailure);
+    }
 
-    if (games[gameNumber].isStarted == -1) 
-        games[gameNumber].isStarted = 0;
-    else {
-        WaitForSingleObject(hUsersMutex, INFINITE);
-        int firstPlayerNumber = searchUserByUID(games[gameNumber].player[0]);
-        int secondPlayerNumber = searchUserByUID(games[gameNumber].player[1]);
+    // Placed field can't be changed
+    int isStarted = submitField(*game, playerNumber, request.field);
+    if (isStarted == -1) {
+        gameMutex->unlock();
+        return Respond(kFailure);
+    }
+    journalFieldPlaced(game->id, playerNumber, request.field);
+    game->lastActivity[playerNumber] = tickCount();
+
+    if (isStarted == 1) {
+        lockMutexShared(usersMutex, metrics.usersLock);
+        User* firstPlayer = getUserByUID(game->player[0]);
+        User* secondPlayer = getUserByUID(game->player[1]);
+        usersMutex.unlock_shared();
 
         std::string additionalMessage = std::string(1, kStartGame) + std::string(1, kMessagePartsDelimiter) + "Y";
-        addMessageToUser(firstPlayerNumber, additionalMessage);
+        sendMessageToUser(firstPlayer, additionalMessage);
 
         additionalMessage = std::string(1, kStartGame) + std::string(1, kMessagePartsDelimiter) + "N";
-        addMessageToUser(secondPlayerNumber, additionalMessage);
+        sendMessageToUser(secondPlayer, additionalMessage);
+    }
+    gameMutex->unlock();
+    return Respond(kFieldCheck);
+}
 
-        ReleaseMutex(hUsersMutex);
+// Player's move handler
+Respond doActionHandler(const Request& request) {
+    int row = request.row, column = request.column, result;
+    if (!correctCoordinate(row) || !correctCoordinate(column))
+        return Respond(kFailure);
+
+    std::mutex* gameMutex;
+    Game* game = lockGame(request, gameMutex);
+
+    if (game == nullptr)
+        return Respond(kFailure);
+
+    // Moves are made in turn after both fields are placed, every cell is shot once
+    int currentPlayerNumber = searchPlayer(*game, request.uniqueID);
+    int enemyNumber = 1 - currentPlayerNumber;
+    if (currentPlayerNumber == -1 || game->isStarted != 1 || moverOf(*game) != currentPlayerNumber
+        || (game->fields[enemyNumber].hits | game->fields[enemyNumber].misses).test(row * kBoardStride + column)) {
+        gameMutex->unlock();
+        return Respond(kFailure);
     }
-    ReleaseMutex(hGamesMutex);
-    return std::string(1, kFieldCheck);
+
+    // Shots are made at opposite player's field
+    result = shootAt(game->fields[enemyNumber], row, column);
+    journalShot(game->id, enemyNumber, row, column);
+    game->lastActivity[currentPlayerNumber] = tickCount();
+    
+    lockMutexShared(usersMutex, metrics.usersLock);
+    User* oppositePlayer = getUserByUID(game->player[enemyNumber]);
+    User* activePlayer = getUserByUID(game->player[currentPlayerNumber]);
+    usersMutex.unlock_shared();
+
+    std::string additionalMessage = std::string(1, kEnemyAction) + std::string(1, kMessagePartsDelimiter)
+        + std::string(1, row + '0') + std::string(1, column + '0') + std::string(1, result + '0');
+    sendMessageToUser(oppositePlayer, additionalMessage);
+
+    bool isGameEnded = game->fields[enemyNumber].aliveCells == 0;
+    if (isGameEnded && activePlayer != nullptr) {
+        std::string message = std::string(1, kGameEnd) + std::string(1, kMessagePartsDelimiter)
+            + activePlayer->login;
+        sendMessageToUser(oppositePlayer, message);
+        sendMessageToUser(activePlayer, message);
+    }
+
+    // Bot moves right after player's miss
+    bool isBotTurn = game->player[enemyNumber] == kBotUID && result == kDamagedSea;
+    if (!isGameEnded && isBotTurn)
+        isGameEnded = playBotMoves(*game, activePlayer);
+
+    if (isGameEnded) {
+        lockMutex(gamesMutex, metrics.gamesLock);
+        removeGame(searchGameByID(game->id));
+        journalGameRemoved(game->id);
+        unlockMutex(gamesMutex, metrics.gamesLock);
+    }
+    gameMutex->unlock();
+
+    Respond respond(kDoAction);
+    respond.result = result;
+    return respond;
 }
 
-// Check if player have any alive ship
-bool hasAliveShips(int gameNumber, int player) {
-    for (int row = 0; row < 10; ++row) {
-        for (int column = 0; column < 10; ++column) {
-            if (games[gameNumber].field[row][column + 10 * player] == kShip)
-                return true;
-        }
+// Register user of other shard request handler. Router sends it after login, so games know user's login
+Respond registerUserHandler(const Request& request) {
+    if (shardCount == 1 || shardOfUser(request.uniqueID) == shardNumber)
+        return Respond(kFailure);
+
+    lockMutex(usersMutex, metrics.usersLock);
+    if (uniqueIdentity(request.uniqueID) && uniqueUserLogin(request.login)) {
+        addUser(std::string(request.login), request.uniqueID);
+        journalUserAdded(request.uniqueID, request.login);
     }
-    return false;
+    unlockMutex(usersMutex, metrics.usersLock);
+
+    Respond respond(kRegisterUser);
+    respond.uniqueID = request.uniqueID;
+    return respond;
 }
 
-// Check if coordinate is correct
-bool correctCoordinate(int number) {
-    return number >= 0 && number < 10;
+// Deliver message from other shard request handler
+Respond deliverMessageHandler(const Request& request) {
+    if (shardCount == 1 || shardOfUser(request.uniqueID) != shardNumber)
+        return Respond(kFailure);
+
+    sendMessageToUser(findUser(request.uniqueID), std::string(request.message));
+    return Respond(kNothing);
 }
 
-// Check if ship is alive
-bool isShipAlive(int gameNumber, int row, int column, int columnOffset) {
-    std::queue<std::pair<int, int>> queue, editedTiles;
-    queue.push(std::pair<int, int>(row, column));
-    games[gameNumber].field[row][column] = 2;
+// Remove user of other shard request handler. His own shard has removed him as idle
+Respond expireUserHandler(const Request& request) {
+    if (shardCount == 1 || shardOfUser(request.uniqueID) == shardNumber)
+        return Respond(kFailure);
 
-    int dColumn[8] = { -1,  0,  1, -1, 1, -1, 0, 1 };
-    int dRow[8] = { -1, -1, -1,  0, 0,  1, 1, 1 };
-    while (!queue.empty()) {
-        int tileRow = queue.front().first, tileColumn = queue.front().second;
-        queue.pop();
+    lockMutex(usersMutex, metrics.usersLock);
+    int userNumber = searchUserByUID(request.uniqueID);
+    if (userNumber != -1) {
+        removeUser(userNumber);
+        journalUserRemoved(request.uniqueID);
+    }
+    unlockMutex(usersMutex, metrics.usersLock);
+    return Respond(kNothing);
+}
 
-        if (games[gameNumber].field[tileRow][tileColumn] == kDamagedShip) {
-            games[gameNumber].field[tileRow][tileColumn] = kUnknownTile;
-            editedTiles.push(std::pair<int, int>(tileRow, tileColumn));
+// ===========================================================================================
+//
+//                                   Long polling
+//
+// ===========================================================================================
 
-            for (int i = 0; i < 8; ++i)
-                if (correctCoordinate(tileColumn + dColumn[i] - columnOffset) && correctCoordinate(tileRow + dRow[i]))
-                    queue.push(std::pair<int, int>(tileRow + dRow[i], tileColumn + dColumn[i]));
-        }
-        
-        if (games[gameNumber].field[tileRow][tileColumn] == kShip) {
-            while (!editedTiles.empty()) {
-                tileRow = editedTiles.front().first, tileColumn = editedTiles.front().second;
-                editedTiles.pop();
-                games[gameNumber].field[tileRow][tileColumn] = kDamagedShip;
-            }
+// Routing frames of client request. Respond can be sent later with the same envelope from any worker.
+// Pipelined client adds request ID frame, router adds its identity: [router][client][request ID][empty]
+const int kMaxEnvelopeFrames = 6;
+typedef struct structEnvelope {
+    zmq::message_t frames[kMaxEnvelopeFrames];
+    int size = 0;
+} Envelope;
+
+// Poll request waiting for saved messages
+typedef struct structParkedPoll {
+    User* user;
+    Envelope envelope;
+    bool isBinary;
+    uint64_t deadline;
+    std::string savedMessages; // Filled when poll is woken
+} ParkedPoll;
+
+const int kMaxPollTimeout = 30000; // Max time poll can wait for messages, ms
+const int kParkedPollsCheckInterval = 100; // How often workers check expired polls, ms
+
+// Parked polls (UID -> poll) and their deadlines. Guarded by parked polls mutex
+std::unordered_map<uint64_t, ParkedPoll> parkedPolls;
+std::priority_queue<std::pair<uint64_t, uint64_t>, std::vector<std::pair<uint64_t, uint64_t>>,
+    std::greater<std::pair<uint64_t, uint64_t>>> parkedPollDeadlines;
+
+// Receive request: routing frames and request body. Returns false on timeout
+bool receiveRequest(zmq::socket_t& socket, Envelope& envelope, zmq::message_t& body) {
+    envelope.size = 0;
+    while (true) {
+        zmq::message_t frame;
+        if (!socket.recv(frame, zmq::recv_flags::none))
+            return false;
+
+        // Body is the last frame
+        if (!frame.more()) {
+            body = std::move(frame);
             return true;
         }
+
+        if (envelope.size < kMaxEnvelopeFrames)
+            envelope.frames[envelope.size++] = std::move(frame);
     }
+}
 
-    while (!editedTiles.empty()) {
-        int tileRow = editedTiles.front().first, tileColumn = editedTiles.front().second;
-        editedTiles.pop();
-        games[gameNumber].field[tileRow][tileColumn] = kDamagedShip;
+// Send respond with saved messages to client of envelope
+void sendRespond(zmq::socket_t& socket, Envelope& envelope, const std::string& respond, char respondType,
+    bool isBinary, const std::string& savedMessages) {
+    for (int i = 0; i < envelope.size; ++i)
+        socket.send(envelope.frames[i], zmq::send_flags::sndmore);
+
+    // Text protocol glues saved messages to respond
+    if (!isBinary) {
+        std::string message = respond;
+        if (!savedMessages.empty())
+            message += std::string(1, kMessageDelimiter) + savedMessages;
+
+        // Logging
+        if (message != "N")
+            logDebug("Send respond [", message, "]");
+
+        zmq::message_t reply(message);
+        socket.send(reply, zmq::send_flags::none);
+        return;
+    }
+
+    // Logging
+    if (respondType != kNothing || !savedMessages.empty())
+        logDebug("Send binary respond [", respondType, "] with messages [", savedMessages, "]");
+
+    // Binary protocol sends saved messages as next frames
+    zmq::message_t reply(respond);
+    socket.send(reply, savedMessages.empty() ? zmq::send_flags::none : zmq::send_flags::sndmore);
+
+    std::string_view messages = savedMessages;
+    while (!messages.empty()) {
+        std::string_view additionalMessage = takeMessagePart(messages, kMessageDelimiter);
+        zmq::message_t additionalReply(additionalMessage.data(), additionalMessage.size());
+        socket.send(additionalReply, messages.empty() ? zmq::send_flags::none : zmq::send_flags::sndmore);
     }
-    return false;
 }
 
-// Player's move handler
-std::string doActionHandler(const std::vector<std::string>& message) {
-    WaitForSingleObject(hGamesMutex, INFINITE);
-    int gameNumber = searchGameByName(message[2]);
-
-    int currentPlayerNumber, columnOffset;
-    if (message[1] == games[gameNumber].player[0]) {
-        currentPlayerNumber = 0;
-        columnOffset = 10;
-    }
-    else {
-        currentPlayerNumber = 1;
-        columnOffset = 0;
-    }
-
-    int row = message[3][0] - '0', column = message[3][1] - '0' + columnOffset, result;
-    switch (games[gameNumber].field[row][column]) {
-    case kSea:
-        games[gameNumber].field[row][column] = kDamagedSea;
-        result = kDamagedSea;
-        break;
-    case kShip:
-        games[gameNumber].field[row][column] = kDamagedShip;
-        result = kDamagedShip;
-        if (!isShipAlive(gameNumber, row, column, columnOffset))
-            result = kDestroyed;
-        break;
-    default:
-        result = games[gameNumber].field[row][column];
-        break;
+// Send nothing respond with saved messages to parked poll
+void sendParkedPollRespond(zmq::socket_t& socket, ParkedPoll& poll) {
+    sendRespond(socket, poll.envelope, encodeRespond(Respond(kNothing), poll.isBinary), kNothing,
+        poll.isBinary, poll.savedMessages);
+}
+
+// Respond to parked polls of users who got messages
+void wakeParkedPolls(zmq::socket_t& socket) {
+    std::vector<ParkedPoll> wokenPolls;
+    parkedPollsMutex.lock();
+    for (User* user : notifiedUsers) {
+        auto poll = parkedPolls.find(user->uniqueID);
+        if (poll == parkedPolls.end() || takeUserMessages(*user, poll->second.savedMessages) == 0)
+            continue;
+
+        user->isPollParked = false;
+        wokenPolls.push_back(std::move(poll->second));
+        parkedPolls.erase(poll);
     }
-    
-    WaitForSingleObject(hUsersMutex, INFINITE);
-    int oppositePlayerNumber = searchUserByUID(games[gameNumber].player[1 - currentPlayerNumber]);
-    std::string additionalMessage = std::string(1, kEnemyAction) + std::string(1, kMessagePartsDelimiter)
-        + std::string(1, row + '0') + std::string(1, column + '0' - columnOffset) + std::string(1, result + '0');
-    addMessageToUser(oppositePlayerNumber, additionalMessage);
+    notifiedUsers.clear();
+    parkedPollsMutex.unlock();
 
-    if (!hasAliveShips(gameNumber, 1 - currentPlayerNumber)) {
-        int activePlayerNumber = searchUserByUID(games[gameNumber].player[currentPlayerNumber]);
-        int loserPlayerNumber = oppositePlayerNumber;
-        std::string message = std::string(1, kGameEnd) + std::string(1, kMessagePartsDelimiter)
-            + users[activePlayerNumber].login;
-        addMessageToUser(loserPlayerNumber, message);
-        addMessageToUser(activePlayerNumber, message);
+    for (ParkedPoll& poll : wokenPolls)
+        sendParkedPollRespond(socket, poll);
+}
 
-        games.erase(games.begin() + gameNumber);
+// Respond to parked polls which waited too long
+void expireParkedPolls(zmq::socket_t& socket) {
+    std::vector<ParkedPoll> expiredPolls;
+    uint64_t now = tickCount();
+    parkedPollsMutex.lock();
+    while (!parkedPollDeadlines.empty() && parkedPollDeadlines.top().first <= now) {
+        auto poll = parkedPolls.find(parkedPollDeadlines.top().second);
+        parkedPollDeadlines.pop();
+
+        // Poll could be woken or replaced by newer one
+        if (poll == parkedPolls.end() || poll->second.deadline > now)
+            continue;
+
+        poll->second.user->isPollParked = false;
+        expiredPolls.push_back(std::move(poll->second));
+        parkedPolls.erase(poll);
     }
+    parkedPollsMutex.unlock();
 
-    ReleaseMutex(hGamesMutex);
-    ReleaseMutex(hUsersMutex);
+    for (ParkedPoll& poll : expiredPolls)
+        sendParkedPollRespond(socket, poll);
+}
 
-    return std::string(1, kDoAction) + std::string(1, kMessagePartsDelimiter) 
-        + std::string(1, result + '0');
+// Connects sockets to other shards. Messages for their users are sent without respond
+std::vector<zmq::socket_t> connectShards(zmq::context_t& context) {
+    std::vector<zmq::socket_t> shards(shardCount);
+    for (int shard = 0; shard < shardCount; ++shard) {
+        if (shard == shardNumber)
+            continue;
+        shards[shard] = zmq::socket_t(context, ZMQ_DEALER);
+        shards[shard].connect(config.shardEndpoints[shard]);
+    }
+    return shards;
+}
+
+// Sends messages for users of other shards. Shard which is down doesn't block worker, its messages are dropped
+void sendRemoteMessages(std::vector<zmq::socket_t>& shards) {
+    std::vector<std::pair<int, std::string>> messages;
+    remoteMessagesMutex.lock();
+    messages.swap(remoteMessages);
+    remoteMessagesMutex.unlock();
+
+    for (auto& [shard, message] : messages) {
+        zmq::message_t delimiter, request(message);
+        if (!shards[shard].send(delimiter, zmq::send_flags::sndmore | zmq::send_flags::dontwait)) {
+            logWarning("Shard ", shard, " is not available. Message [", message, "] is dropped");
+            continue;
+        }
+        shards[shard].send(request, zmq::send_flags::none);
+    }
 }
 
 // ===========================================================================================
@@ -323,110 +671,448 @@ std::string doActionHandler(const std::vector<std::string>& message) {
 //
 // ===========================================================================================
 
-DWORD WINAPI workerThread(LPVOID arg) {
-    zmq::context_t* context = (zmq::context_t*)arg;
+void workerThread(zmq::context_t* context, int worker, int core) {
+    if (core != -1 && !pinThread(core))
+        logWarning("Unable to pin worker to core ", core);
 
-    zmq::socket_t socket(*context, ZMQ_REP);
-    socket.connect(kWorkersPort);
+    // Dealer socket keeps routing frames, so respond to parked poll can be sent later
+    zmq::socket_t socket(*context, ZMQ_DEALER);
+    socket.set(zmq::sockopt::rcvtimeo, kParkedPollsCheckInterval);
+    socket.set(zmq::sockopt::sndhwm, config.highWaterMark);
+    socket.set(zmq::sockopt::rcvhwm, config.highWaterMark);
+    socket.connect(config.workersPort);
+    std::vector<zmq::socket_t> shards = connectShards(*context);
 
+    uint64_t idleStart = metricsClock();
     while (true) {
         // Get request from client
-        zmq::message_t request;
-        socket.recv(request, zmq::recv_flags::none);
-        std::string message = request.to_string();
+        Envelope envelope;
+        zmq::message_t requestMessage;
+        if (!receiveRequest(socket, envelope, requestMessage)) {
+            // Reaper adds messages without requests, so they are sent when workers are idle too
+            expireParkedPolls(socket);
+            wakeParkedPolls(socket);
+            sendRemoteMessages(shards);
+            continue;
+        }
+        --metrics.queuedRequests;
+        workerEpochs[worker].store(userRemovalEpoch.load() + 1);
+
+        uint64_t busyStart = metricsClock();
+        metrics.workerIdleTime += busyStart - idleStart;
+
+        Request request;
+        bool isCorrect = decodeRequest(requestMessage, request);
+
+        // Log
+        if (request.type != kNothing) {
+            if (request.isBinary)
+                logDebug("Received binary message [", request.type, "]");
+            else
+                logDebug("Received message [", requestMessage.to_string_view(), "]");
+        }
 
-        // Console log
-        if (message[0] != kNothing)
-            std::cout << "Received message [" << message << "]" << std::endl;
+        // Token of user is resolved before handler runs, request with unknown or expired token fails
+        bool isInternal = request.type == kRegisterUser || request.type == kDeliverMessage || request.type == kExpireUser;
+        User* user = isCorrect && request.type != kLogin && !isInternal ? findUser(request.uniqueID) : nullptr;
+        if (isCorrect && request.type != kLogin && !isInternal && user == nullptr)
+            isCorrect = false;
 
         // Handle message
-        std::vector<std::string> messageParts = splitString(message, std::string(1, kMessagePartsDelimiter));
-        switch (message[0]) {
-        case kLogin:
-            message = userLoginHandler(messageParts);
-            break;
-        case kCreateGame:
-            message = createGameHandler(messageParts);
-            break;
-        case kGetGameList:
-            message = getGameListHandler(messageParts);
-            break;
-        case kJoinGame:
-            message = joinGameHandler(messageParts);
-            break;
-        case kInvitePlayer:
-            message = invitePlayerHandler(messageParts);
-            break;
-        case kFieldCheck:
-            message = fieldCheckHandler(messageParts);
-            break;
-        case kDoAction:
-            message = doActionHandler(messageParts);
-            break;
-        default:
-            message = std::string(1, kNothing);
-            break;
+        Respond respond(kFailure);
+        if (isCorrect) {
+            switch (request.type) {
+            case kLogin:
+                respond = userLoginHandler(request);
+                break;
+            case kCreateGame:
+                respond = createGameHandler(request);
+                break;
+            case kGetGameList:
+                respond = getGameListHandler(request);
+                break;
+            case kGameListChanges:
+                respond = gameListChangesHandler(request);
+                break;
+            case kJoinGame:
+                respond = joinGameHandler(request);
+                break;
+            case kPlayBot:
+                respond = playBotHandler(request);
+                break;
+            case kInvitePlayer:
+                respond = invitePlayerHandler(request);
+                break;
+            case kFieldCheck:
+                respond = fieldCheckHandler(request);
+                break;
+            case kDoAction:
+                respond = doActionHandler(request);
+                break;
+            case kRegisterUser:
+                respond = registerUserHandler(request);
+                break;
+            case kDeliverMessage:
+                respond = deliverMessageHandler(request);
+                break;
+            case kExpireUser:
+                respond = expireUserHandler(request);
+                break;
+            default:
+                respond = Respond(kNothing);
+                break;
+            }
         }
 
-        // Attach saved messages
-        if (messageParts[0][0] != kLogin) {
-            int userNumber = searchUserByUID(messageParts[1]);
-            if (!users[userNumber].message.empty()) {
-                message += std::string(1, kMessageDelimiter) + users[userNumber].message;
-                users[userNumber].message.erase();
+        if (respond.type == kFailure)
+            ++metrics.failedRequests;
+
+        // Take saved messages. Poll without messages waits for them
+        std::string savedMessages;
+        bool isParked = false, hasReplacedPoll = false;
+        ParkedPoll replacedPoll;
+        if (user != nullptr)
+            user->lastActivity.store(tickCount(), std::memory_order_relaxed);
+        if (user != nullptr && isCorrect && request.type == kNothing && request.timeout > 0) {
+            parkedPollsMutex.lock();
+
+            // Pairs with fence in addMessageToUser, so either we see message or producer sees parked poll
+            user->isPollParked = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (takeUserMessages(*user, savedMessages) == 0) {
+                // Previous poll of the same user is answered right away
+                auto poll = parkedPolls.find(request.uniqueID);
+                if (poll != parkedPolls.end()) {
+                    replacedPoll = std::move(poll->second);
+                    hasReplacedPoll = true;
+                    parkedPolls.erase(poll);
+                }
+
+                ParkedPoll& parkedPoll = parkedPolls[request.uniqueID];
+                parkedPoll.user = user;
+                parkedPoll.envelope = std::move(envelope);
+                parkedPoll.isBinary = request.isBinary;
+                parkedPoll.deadline = tickCount() + (std::min)(request.timeout, kMaxPollTimeout);
+                parkedPollDeadlines.push(std::make_pair(parkedPoll.deadline, request.uniqueID));
+                isParked = true;
             }
+            else if (parkedPolls.find(request.uniqueID) == parkedPolls.end())
+                user->isPollParked = false;
+            parkedPollsMutex.unlock();
         }
-        
-        // Logging
-        if (message != "N")
-            std::cout << "Send respond [" << message << "]" << std::endl;
+        else if (user != nullptr)
+            takeUserMessages(*user, savedMessages);
 
-        // Send respond
-        zmq::message_t reply(message);
-        socket.send(reply, zmq::send_flags::none);
+        if (hasReplacedPoll)
+            sendParkedPollRespond(socket, replacedPoll);
+
+        // Send respond. Other shards don't wait for respond to delivered message and removed user
+        if (!isParked && request.type != kDeliverMessage && request.type != kExpireUser)
+            sendRespond(socket, envelope, encodeRespond(respond, request.isBinary), respond.type,
+                request.isBinary, savedMessages);
+
+        wakeParkedPolls(socket);
+        sendRemoteMessages(shards);
+        workerEpochs[worker].store(0);
+
+        idleStart = metricsClock();
+        recordRequest(request.type, idleStart - busyStart);
+        metrics.workerBusyTime += idleStart - busyStart;
     }
+}
 
-    return 0;
+// ===========================================================================================
+//
+//                                   Idle expiry
+//
+// ===========================================================================================
+
+// Removes user from notified users and makes his parked poll be answered at once. Called after user is removed,
+// so only workers whose requests started before removal can add them again
+void dropUserPolls(User* user) {
+    parkedPollsMutex.lock();
+    notifiedUsers.erase(std::remove(notifiedUsers.begin(), notifiedUsers.end(), user), notifiedUsers.end());
+    auto poll = parkedPolls.find(user->uniqueID);
+    if (poll != parkedPolls.end()) {
+        poll->second.deadline = 0;
+        parkedPollDeadlines.push(std::make_pair(0, user->uniqueID));
+    }
+    parkedPollsMutex.unlock();
 }
 
+// Gets oldest removal epoch seen by workers which handle requests. Slots of users removed before it are free
+uint64_t oldestWorkerEpoch() {
+    uint64_t oldest = UINT64_MAX;
+    for (int worker = 0; worker < config.workerThreads; ++worker) {
+        uint64_t epoch = workerEpochs[worker].load();
+        if (epoch != 0)
+            oldest = (std::min)(oldest, epoch);
+    }
+    return oldest;
+}
 
+// Removes user who made no requests for idle timeout. Other shards remove their copies of him
+void expireUser(const ExpiryTimer& timer, uint64_t now) {
+    lockMutex(usersMutex, metrics.usersLock);
+    if (searchUserByUID(timer.id) != timer.number) {
+        unlockMutex(usersMutex, metrics.usersLock);
+        return;
+    }
+
+    // Parked poll is activity too, user is checked again after timeout
+    User& user = users[timer.number];
+    uint64_t deadline = (user.isPollParked ? now : user.lastActivity.load()) + userIdleTimeout;
+    if (deadline > now) {
+        unlockMutex(usersMutex, metrics.usersLock);
+        scheduleExpiry({ deadline, timer.number, timer.id, false });
+        return;
+    }
+
+    logInfo("User {", user.login, "} is idle and removed");
+    removeUser(timer.number);
+    journalUserRemoved(timer.id);
+    dropUserPolls(&user);
+    unlockMutex(usersMutex, metrics.usersLock);
+    ++metrics.expiredUsers;
+
+    std::string request = std::string(1, kExpireUser) + std::string(1, kMessagePartsDelimiter) + std::to_string(timer.id);
+    remoteMessagesMutex.lock();
+    for (int shard = 0; shard < shardCount; ++shard)
+        if (shard != shardNumber)
+            remoteMessages.emplace_back(shard, request);
+    remoteMessagesMutex.unlock();
+}
+
+// Ends game without moves for idle timeout. Player who moved last waits for other one, so he wins
+void expireGame(const ExpiryTimer& timer, uint64_t now) {
+    lockMutexShared(gamesMutex, metrics.gamesLock);
+    Game* game = &games[timer.number];
+    std::mutex* gameMutex = &gameMutexes[timer.number];
+    gamesMutex.unlock_shared();
+
+    gameMutex->lock();
+    if (game->id != (int)timer.id) {
+        gameMutex->unlock();
+        return;
+    }
+
+    uint64_t deadline = (std::max)(game->lastActivity[0], game->lastActivity[1]) + gameIdleTimeout;
+    if (deadline > now) {
+        gameMutex->unlock();
+        scheduleExpiry({ deadline, timer.number, timer.id, true });
+        return;
+    }
 
+    // Game which nobody joined is just closed
+    if (game->player[1] != 0) {
+        int winner = game->lastActivity[1] > game->lastActivity[0] ? 1 : 0;
+        lockMutexShared(usersMutex, metrics.usersLock);
+        User* winnerPlayer = getUserByUID(game->player[winner]);
+        User* loserPlayer = getUserByUID(game->player[1 - winner]);
+        usersMutex.unlock_shared();
+
+        // Bot has no user, it wins for itself
+        if (winnerPlayer != nullptr || game->player[winner] == kBotUID) {
+            std::string message = std::string(1, kGameEnd) + std::string(1, kMessagePartsDelimiter)
+                + (winnerPlayer != nullptr ? winnerPlayer->login : std::string(kBotLogin));
+            sendMessageToUser(winnerPlayer, message);
+            sendMessageToUser(loserPlayer, message);
+        }
+    }
 
-int main() {
+    logInfo("Game {", game->name, "} is idle and ended");
+    lockMutex(gamesMutex, metrics.gamesLock);
+    removeGame(timer.number);
+    journalGameRemoved(game->id);
+    unlockMutex(gamesMutex, metrics.gamesLock);
+    gameMutex->unlock();
+    ++metrics.expiredGames;
+}
+
+// Reaper thread. Checks timers of idle users and games and gives slots of removed users for reuse
+void expiryThread() {
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kExpiryTick));
+        uint64_t now = tickCount();
+
+        std::vector<ExpiryTimer> timers;
+        takeExpiredTimers(now, timers);
+        for (const ExpiryTimer& timer : timers) {
+            if (timer.isGame)
+                expireGame(timer, now);
+            else
+                expireUser(timer, now);
+        }
+
+        lockMutex(usersMutex, metrics.usersLock);
+        // Workers publish epoch before they look for users, and look for them under users mutex
+        reuseUserSlots(oldestWorkerEpoch());
+        unlockMutex(usersMutex, metrics.usersLock);
+    }
+}
+
+// ===========================================================================================
+//
+//                                  Proxy and admin
+//
+// ===========================================================================================
+
+// Moves multipart message from one socket to another
+void forwardMessage(zmq::socket_t& from, zmq::socket_t& to) {
+    zmq::message_t frame;
+    do {
+        from.recv(frame, zmq::recv_flags::none);
+        to.send(frame, frame.more() ? zmq::send_flags::sndmore : zmq::send_flags::none);
+    } while (frame.more());
+}
+
+// Proxy between clients router and workers dealer. Counts requests waiting for workers
+void runProxy(zmq::socket_t& clients, zmq::socket_t& workers) {
+    zmq::pollitem_t items[] = {
+        { clients.handle(), 0, ZMQ_POLLIN, 0 },
+        { workers.handle(), 0, ZMQ_POLLIN, 0 }
+    };
+
+    while (true) {
+        zmq::poll(items, 2, std::chrono::milliseconds(-1));
+
+        if (items[0].revents & ZMQ_POLLIN) {
+            ++metrics.queuedRequests;
+            forwardMessage(clients, workers);
+        }
+        if (items[1].revents & ZMQ_POLLIN)
+            forwardMessage(workers, clients);
+    }
+}
+
+// Formats server metrics with current numbers of users, games and messages
+std::string collectMetrics() {
+    std::string text = formatMetrics(metrics);
+
+    uint64_t pendingMessages = 0, maxPendingMessages = 0, droppedMessages = 0;
+    lockMutexShared(usersMutex, metrics.usersLock);
+    uint64_t activeUsers = usersByLogin.size();
+    for (User& user : users) {
+        uint64_t size = mailboxSize(user.mailbox);
+        pendingMessages += size;
+        maxPendingMessages = (std::max)(maxPendingMessages, size);
+        droppedMessages += user.mailbox.droppedMessages;
+    }
+    usersMutex.unlock_shared();
+
+    lockMutexShared(gamesMutex, metrics.gamesLock);
+    uint64_t activeGames = games.size() - freeGameSlots.size();
+    gamesMutex.unlock_shared();
+
+    parkedPollsMutex.lock();
+    uint64_t activePolls = parkedPolls.size();
+    parkedPollsMutex.unlock();
+
+    appendMetric(text, "active_users", activeUsers);
+    appendMetric(text, "active_games", activeGames);
+    appendMetric(text, "parked_polls", activePolls);
+    appendMetric(text, "mailbox_pending_messages", pendingMessages);
+    appendMetric(text, "mailbox_max_pending_messages", maxPendingMessages);
+    appendMetric(text, "mailbox_dropped_messages", droppedMessages);
+    return text;
+}
+
+// Admin thread. Answers metrics requests on admin port
+void adminThread(zmq::context_t* context, std::string adminPort) {
+    zmq::socket_t socket(*context, ZMQ_REP);
+    socket.bind(adminPort);
+
+    while (true) {
+        zmq::message_t request;
+        socket.recv(request, zmq::recv_flags::none);
+
+        std::string respond(1, kFailure);
+        if (request.size() > 0 && *static_cast<const char*>(request.data()) == kGetMetrics)
+            respond = std::string(1, kGetMetrics) + std::string(1, kMessagePartsDelimiter) + collectMetrics();
+
+        zmq::message_t reply(respond);
+        socket.send(reply, zmq::send_flags::none);
+    }
+}
+
+
+
+
+// Adds all users and games to snapshot. Returns last given game ID
+int collectSnapshot(std::string& snapshot) {
+    // Slots of removed users are skipped
+    lockMutexShared(usersMutex, metrics.usersLock);
+    for (int userNumber = 0; userNumber < (int)users.size(); ++userNumber)
+        if (searchUserByUID(users[userNumber].uniqueID) == userNumber)
+            appendSnapshotUser(snapshot, users[userNumber]);
+    usersMutex.unlock_shared();
+
+    // Games are copied one by one without games mutex, so no game mutex is waited for under it
+    std::vector<std::pair<int, int>> gameSlots;
+    lockMutexShared(gamesMutex, metrics.gamesLock);
+    int snapshotLastGameID = lastGameID;
+    for (int gameNumber = 0; gameNumber < (int)games.size(); ++gameNumber)
+        if (games[gameNumber].id != 0)
+            gameSlots.emplace_back(gameNumber, games[gameNumber].id);
+    gamesMutex.unlock_shared();
+
+    for (auto& [gameNumber, gameID] : gameSlots) {
+        gameMutexes[gameNumber].lock();
+        if (games[gameNumber].id == gameID)
+            appendSnapshotGame(snapshot, games[gameNumber]);
+        gameMutexes[gameNumber].unlock();
+    }
+    return snapshotLastGameID;
+}
+
+// Server runs alone or as shard (--shard N --shards N), shards are reached through Router. Options are in Config.h
+int main(int argc, char* argv[]) {
     std::cout << "===========================================" << std::endl;
     std::cout << "                  SERVER LOG               " << std::endl;
     std::cout << "===========================================" << std::endl;
 
+    if (!readConfig(argc, argv, config, false))
+        return 1;
+    printConfig(config, false);
+    shardNumber = config.shardNumber;
+    shardCount = config.shardCount;
+    logLevel = config.logLevel;
+    if (!startLogger(config.logFile))
+        std::cout << "Unable to open log " << config.logFile << ", log is written to stdout" << std::endl;
+    userIdleTimeout = (uint64_t)config.sessionTimeout * 1000;
+    gameIdleTimeout = (uint64_t)config.gameTimeout * 1000;
+
+    // Restore users and games saved before restart
+    loadState();
+    startJournal(collectSnapshot);
+
     //  Prepare our context and sockets
-    zmq::context_t context(1);
+    zmq::context_t context(config.ioThreads);
     zmq::socket_t clients(context, ZMQ_ROUTER);
-    clients.bind(kClientPort);
+    clients.set(zmq::sockopt::sndhwm, config.highWaterMark);
+    clients.set(zmq::sockopt::rcvhwm, config.highWaterMark);
+    clients.bind(config.clientPort);
     zmq::socket_t workers(context, ZMQ_DEALER);
-    workers.bind(kWorkersPort);
-
-    // Threads arrays
-    HANDLE threads[kMaxThreads];
-    DWORD dwThreadIdArray[kMaxThreads];
-
-    // Mutexes
-    hUsersMutex = CreateMutex(NULL, FALSE, NULL);
-    hGamesMutex = CreateMutex(NULL, FALSE, NULL);
-
-    //  Launch pool of worker threads
-    for (int i = 0; i < kMaxThreads; ++i) {
-        threads[i] = CreateThread(
-            NULL,                   // default security attributes
-            0,                      // use default stack size  
-            workerThread,       // thread function name
-            &context,          // argument to thread function 
-            0,                      // use default creation flags 
-            &dwThreadIdArray[i]
-        );
-    }
+    workers.set(zmq::sockopt::sndhwm, config.highWaterMark);
+    workers.set(zmq::sockopt::rcvhwm, config.highWaterMark);
+    workers.bind(config.workersPort);
+
+    //  Launch pool of worker threads and admin thread. Pinned workers take cores one by one
+    std::vector<std::thread> threads;
+    int cores = (std::max)(1, (int)std::thread::hardware_concurrency());
+    workerEpochs.reset(new std::atomic<uint64_t>[config.workerThreads]());
+    for (int i = 0; i < config.workerThreads; ++i)
+        threads.emplace_back(workerThread, &context, i, config.pinWorkers ? (config.firstCore + i) % cores : -1);
+    threads.emplace_back(adminThread, &context, config.adminPort);
+    threads.emplace_back(expiryThread);
 
     // Creating Proxy between router and dealer
-    zmq::socket_ref client(clients), worker(workers);
-    zmq::proxy(client, worker);
+    runProxy(clients, workers);
+
+    for (std::thread& thread : threads)
+        thread.join();
 
+    flushLogger();
     return 0;
 }
@@ -2,6 +2,9 @@
 // Ports for messages
 const char kServerPort[] = "tcp://localhost:5555";
 const char kClientPort[] = "tcp://*:5555";
+// Port for admin requests
+const char kAdminServerPort[] = "tcp://localhost:5556";
+const char kAdminPort[] = "tcp://*:5556";
 
 
 // In message delimiter
@@ -16,10 +19,14 @@ const char kMessageDelimiter = '$';
 const char kLogin = 'L'; // [L#Login] req -> [L] res
 
 // Create game request
-const char kCreateGame = 'C'; // [C#UID#GameName] req -> [C] res
+const char kCreateGame = 'C'; // [C#UID#GameName] req -> [C#GameID] res
 
 // Get list of available games request
-const char kGetGameList = 'G'; // [G#UID] req -> [G#Game1#Game2...] res
+// Without cursor whole list is sent, otherwise up to Limit games after Cursor. NextCursor 0 - no more games
+const char kGetGameList = 'G'; // [G#UID] or [G#UID#Cursor#Limit] req -> [G#Version#NextCursor#Game1#Game2...] res
+
+// Get changes of game list since version. [F] res if version is too old, then list should be reloaded
+const char kGameListChanges = 'V'; // [V#UID#Version] req -> [V#NewVersion#+OpenedGame#-ClosedGame...] res
 
 // Send game field request
 const char kFieldCheck = 'M'; // [M#UID#GameName#Map] req -> [M] res
@@ -32,10 +39,24 @@ const char kInvitePlayer = 'I'; // [I#UID#Login1#GameName] req -> [I] res
 // Invited player gets [I#Login#GameName] res -> and then can [J#UID#GameName] req
 
 // Join game request
-const char kJoinGame = 'J'; // [J#UID#GameName] req -> [J] res
+const char kJoinGame = 'J'; // [J#UID#GameName] req -> [J#GameID] res
+
+// Create game with built-in bot as second player. Bot has placed field already, player starts
+const char kPlayBot = 'B'; // [B#UID#GameName] req -> [B#GameID] res
+
+// Get saved messages request. With timeout server waits up to timeout ms for new messages
+const char kNothing = 'N'; // [N#UID] or [N#UID#Timeout]
 
-// Get saved messages request
-const char kNothing = 'N'; // [N#UID]
+// Get server metrics request. Served only on admin port
+const char kGetMetrics = 'T'; // [T] req -> [T#Metrics] res, one "name value" metric per line
+
+// Requests between router and shards. Router doesn't accept them from clients
+// Register user of other shard, so games of this shard know his login
+const char kRegisterUser = 'U'; // [U#UID#Login] req -> [U#UID] res
+// Deliver message to user of this shard. Message is sent as is. No respond
+const char kDeliverMessage = 'X'; // [X#UID#Message] req
+// Remove user of other shard, his own shard has removed him as idle. No respond
+const char kExpireUser = 'Q'; // [Q#UID] req
 
 
 
@@ -53,7 +74,12 @@ const char kGameEnd = 'E'; // [E#Winner] res
 const char kPlayerJoinYourGame = 'P'; // [P#Login] res
 
 // Fail respond
-const char kFailure = 'F';
+const char kFailure = 'F'; // [F] res, or [F#Code] res to field request
+
+// Codes of wrong field in fail respond to field request
+const int kFieldWrongShape = 1; // Ship is not a straight line
+const int kFieldShipsTouch = 2; // Ships touch each other by corner
+const int kFieldWrongFleet = 3; // Ships are not 4, 3, 3, 2, 2, 2, 1, 1, 1, 1
 
 
 
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Sharding of users and games between server processes. Router sends every request to shard owning it:
+// login and game name are hashed, UID and game ID keep number of shard which gave them (number % shard count).
+// Shard count must stay the same while journals of shards are kept.
+const int kMaxShards = 64;
+const int kShardBasePort = 5560;      // Shard takes requests on kShardBasePort + shard number
+const int kShardAdminBasePort = 5660; // Shard takes admin requests on kShardAdminBasePort + shard number
+
+// Shards of this server. Server without shards is one shard
+inline int shardCount = 1;
+inline int shardNumber = 0;
+
+// Hash of login or game name (FNV-1a)
+inline uint32_t shardHash(std::string_view key) {
+    uint32_t hash = 2166136261u;
+    for (char symbol : key) {
+        hash ^= (unsigned char)symbol;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Gets shard of user by login or of game by name
+inline int shardOfName(std::string_view name) {
+    return shardHash(name) % shardCount;
+}
+
+// Gets shard of user by UID
+inline int shardOfUser(uint64_t uniqueID) {
+    return uniqueID % shardCount;
+}
+
+// Gets shard of game by ID
+inline int shardOfGame(int gameID) {
+    return gameID % shardCount;
+}
+
+// Ports of shard
+inline std::string shardServerPort(int shard) {
+    return "tcp://localhost:" + std::to_string(kShardBasePort + shard);
+}
+
+inline std::string shardClientPort(int shard) {
+    return "tcp://*:" + std::to_string(kShardBasePort + shard);
+}
+
+inline std::string shardAdminPort(int shard) {
+    return "tcp://*:" + std::to_string(kShardAdminBasePort + shard);
+}
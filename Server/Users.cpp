@@ -1,59 +1,210 @@
+#include <algorithm>
 #include <iostream>
-#include <vector>
 #include <random>
 #include <string>
 
 #include "Users.h"
 #include "ServerConnection.h"
+#include "Sharding.h"
+#include "Logger.h"
+#include "Expiry.h"
 
-structUser::structUser(std::string userLogin) {
-    login = userLogin;
+std::mt19937_64 uniqueIDRandom(std::random_device{}()); // Used under users mutex
 
-    std::mt19937 mt_rand(time(0));
-    do 
-        uniqueID = std::to_string(mt_rand());
-    while (!uniqueIdentity(uniqueID));
+structUser::structUser() {
+    uniqueID = 0;
+    generation = 0;
+    isRemoved = false;
+    isPollParked = false;
+    lastActivity = 0;
+}
+
+// Checks if UID was given by this shard
+bool isLocalUser(uint64_t uniqueID) {
+    return shardOfUser(uniqueID) == shardNumber;
+}
+
+// Makes UID of user in slot. Random part keeps number of shard in UID % shard count
+uint64_t newUniqueID(int slot, uint8_t generation) {
+    uint64_t random = kMaxShards + uniqueIDRandom() % (((uint64_t)1 << kUserGenerationShift) - 2 * kMaxShards);
+    uint64_t uniqueID = ((uint64_t)slot << kUserSlotShift) | ((uint64_t)generation << kUserGenerationShift) | random;
+    return uniqueID + shardNumber - uniqueID % shardCount;
+}
+
+// Takes free slot. Returns -1 if there are no free slots
+int takeFreeUserSlot() {
+    if (!freeUserSlots.empty()) {
+        int userNumber = freeUserSlots.back();
+        freeUserSlots.pop_back();
+        return userNumber;
+    }
+    if (users.size() >= kMaxUserSlots)
+        return -1;
+    users.emplace_back();
+    return (int)users.size() - 1;
+}
+
+// Takes slot of restored user's UID. User of other shard in this slot is moved to other slot,
+// because slots of other shards users aren't kept in their UIDs. Returns -1 if slot is taken
+int takeUserSlot(int slot) {
+    if (slot >= kMaxUserSlots)
+        return -1;
+    while ((int)users.size() <= slot) {
+        freeUserSlots.push_back((int)users.size());
+        users.emplace_back();
+    }
+
+    auto freeSlot = std::find(freeUserSlots.begin(), freeUserSlots.end(), slot);
+    if (freeSlot != freeUserSlots.end()) {
+        *freeSlot = freeUserSlots.back();
+        freeUserSlots.pop_back();
+        return slot;
+    }
+
+    User& occupant = users[slot];
+    if (occupant.uniqueID == 0 || occupant.isRemoved || isLocalUser(occupant.uniqueID))
+        return -1;
+
+    int userNumber = takeFreeUserSlot();
+    if (userNumber == -1)
+        return -1;
+    User& movedUser = users[userNumber];
+    usersByLogin.erase(occupant.login);
+    movedUser.uniqueID = occupant.uniqueID;
+    movedUser.login.swap(occupant.login);
+    movedUser.gameName.swap(occupant.gameName);
+    movedUser.lastActivity = occupant.lastActivity.load();
+    usersByLogin[movedUser.login] = userNumber;
+    remoteUsersByUID[movedUser.uniqueID] = userNumber;
+    occupant.uniqueID = 0;
+    return slot;
+}
+
+// Creates user with login and adds him to indexes. Returns number of user, -1 if there are no free slots.
+// New UID is generated if uniqueID is 0, restored user of this shard takes slot of his UID
+int addUser(const std::string& login, uint64_t uniqueID) {
+    bool isLocal = uniqueID == 0 || isLocalUser(uniqueID);
+    int userNumber = isLocal && uniqueID != 0 ? takeUserSlot((int)(uniqueID >> kUserSlotShift)) : takeFreeUserSlot();
+    if (userNumber == -1)
+        return -1;
+
+    // Slot was cleared when it was freed
+    User& user = users[userNumber];
+    if (uniqueID == 0) {
+        uniqueID = newUniqueID(userNumber, ++user.generation);
+        logInfo("Create user {", login, "} with UID [", uniqueID, "]");
+    }
+    else if (isLocal)
+        user.generation = (uint8_t)(uniqueID >> kUserGenerationShift);
+    user.uniqueID = uniqueID;
+    user.login = login;
+    user.lastActivity = tickCount();
 
-    std::cout << "Create user {" << login << "} with UID [" << uniqueID << "]" << std::endl;
+    usersByLogin[user.login] = userNumber;
+    // Users of other shards are removed by their shard
+    if (!isLocal)
+        remoteUsersByUID[uniqueID] = userNumber;
+    else if (userIdleTimeout != 0)
+        scheduleExpiry({ user.lastActivity + userIdleTimeout, userNumber, uniqueID, false });
+    return userNumber;
 }
 
-// Check if UID is occupied
-bool uniqueIdentity(std::string uniqueID) {
-    for (User user : users)
-        if (user.uniqueID == uniqueID)
-            return false;
-    return true;
+// Removes user from indexes. Slot is reused when nobody can hold pointer to user
+void removeUser(int userNumber) {
+    User& user = users[userNumber];
+    usersByLogin.erase(user.login);
+    if (!isLocalUser(user.uniqueID))
+        remoteUsersByUID.erase(user.uniqueID);
+    user.isRemoved = true;
+    removedUserSlots.emplace_back(++userRemovalEpoch, userNumber);
+}
+
+// Clears slots of users removed before epoch whose polls aren't parked and gives them to new users
+void reuseUserSlots(uint64_t removedBefore) {
+    while (!removedUserSlots.empty() && removedUserSlots.front().first < removedBefore) {
+        // Parked poll keeps pointer to user until it is answered
+        User& user = users[removedUserSlots.front().second];
+        if (user.isPollParked)
+            break;
+
+        std::string().swap(user.login);
+        std::string().swap(user.gameName);
+        user.uniqueID = 0;
+        user.isRemoved = false;
+        user.isPollParked = false;
+
+        // Messages nobody takes are dropped with their memory
+        std::string message;
+        while (popMessage(user.mailbox, message)) {}
+        user.mailbox.droppedMessages = 0;
+
+        freeUserSlots.push_back(removedUserSlots.front().second);
+        removedUserSlots.pop_front();
+    }
+}
+
+// Check if UID is free
+bool uniqueIdentity(uint64_t uniqueID) {
+    return searchUserByUID(uniqueID) == -1;
 }
 
 // Check if login is occupied
-bool uniqueUserLogin(std::string name) {
-    for (User user : users)
-        if (user.login == name)
-            return false;
-    return true;
+bool uniqueUserLogin(std::string_view name) {
+    return usersByLogin.find(name) == usersByLogin.end();
 }
 
-// Gets number of user in users by UID
-int searchUserByUID(std::string uniqueID) {
-    for (int i = 0; i < users.size(); ++i)
-        if (users[i].uniqueID == uniqueID)
-            return i;
-    return -1;
+// Gets number of user in users by UID. User of this shard is found by slot of UID without index
+int searchUserByUID(uint64_t uniqueID) {
+    if (uniqueID == 0)
+        return -1;
+
+    if (!isLocalUser(uniqueID)) {
+        auto user = remoteUsersByUID.find(uniqueID);
+        if (user == remoteUsersByUID.end())
+            return -1;
+        return user->second;
+    }
+
+    uint64_t slot = uniqueID >> kUserSlotShift;
+    if (slot >= users.size() || users[slot].uniqueID != uniqueID || users[slot].isRemoved)
+        return -1;
+    return (int)slot;
 }
 
 // Gets number of user in users by Login
-int searchUserByLogin(std::string login) {
-    for (int i = 0; i < users.size(); ++i)
-        if (users[i].login == login)
-            return i;
-    return -1;
-}
-
-// Adds specific message for user
-void addMessageToUser(int userNumber, std::string message) {
-    if (users[userNumber].message.empty()) {
-        users[userNumber].message = message;
-        return;
+int searchUserByLogin(std::string_view login) {
+    auto user = usersByLogin.find(login);
+    if (user == usersByLogin.end())
+        return -1;
+    return user->second;
+}
+
+// Gets user by UID. Returns nullptr if there is no such user
+User* getUserByUID(uint64_t uniqueID) {
+    int userNumber = searchUserByUID(uniqueID);
+    if (userNumber == -1)
+        return nullptr;
+    return &users[userNumber];
+}
+
+// Adds specific message for user. Returns true if user's poll waits for messages
+bool addMessageToUser(User& user, const std::string& message) {
+    if (!pushMessage(user.mailbox, message))
+        logWarning("Mailbox of user {", user.login, "} is full. Message [", message, "] is dropped");
+
+    // Pairs with fence in parked poll, so either poll sees message or we see parked poll
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return user.isPollParked.load(std::memory_order_relaxed);
+}
+
+// Takes all messages of user separated by kMessageDelimiter. Returns number of messages
+int takeUserMessages(User& user, std::string& messages) {
+    int count = 0;
+    std::string message;
+    while (popMessage(user.mailbox, message)) {
+        if (count++ != 0)
+            messages += kMessageDelimiter;
+        messages += message;
     }
-    users[userNumber].message += std::string(1, kMessageDelimiter) + message;
+    return count;
 }
@@ -1,23 +1,74 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Mailbox.h"
+
+// UID is session token of user: [24 bits slot][8 bits generation of slot][32 bits random].
+// User of this shard is found by slot of UID and whole UID is compared, so there is no UID index for them.
+// Random part is adjusted to keep UID % shard count equal to shard number, so router finds user's shard.
+// Users of other shards keep UIDs given by their shard and are found by index
+const int kUserSlotShift = 40;
+const int kUserGenerationShift = 32;
+const int kMaxUserSlots = 1 << 24;
 
 typedef struct structUser {
-    std::string uniqueID, login, gameName, message;
-    structUser(std::string userLogin);
+    uint64_t uniqueID; // 0 - free slot
+    uint8_t generation; // Increased when slot is given to new user of this shard
+    bool isRemoved; // Removed user isn't found while his slot waits for reuse
+    std::string login, gameName;
+    Mailbox mailbox; // Messages for user. Filled without users mutex
+    std::atomic<bool> isPollParked; // User's poll waits for messages
+    std::atomic<uint64_t> lastActivity; // tickCount() of last request
+    structUser();
 } User;
 
-__declspec(selectany) std::vector<User> users;
+// Deque keeps users in place when new users are added, so pointers to users stay valid.
+// Removed user keeps his slot while threads could still hold pointer to him: until every worker has finished
+// requests started before removal and his parked poll is answered. Then slot is cleared and given to new user
+inline std::deque<User> users;
+inline std::vector<int> freeUserSlots;
+inline std::deque<std::pair<uint64_t, int>> removedUserSlots; // Removal epoch -> number of user
+inline std::atomic<uint64_t> userRemovalEpoch{ 0 }; // Increased by every removal, under users mutex
+
+// Indexes for users: Login -> number of user, UID of user of other shard -> number of user.
+// Login keys are views of users logins, so they can be searched by view without copy
+inline std::unordered_map<std::string_view, int> usersByLogin;
+inline std::unordered_map<uint64_t, int> remoteUsersByUID;
+
+// Creates user with login and adds him to indexes. Returns number of user, -1 if there are no free slots.
+// New UID is generated if uniqueID is 0, restored user of this shard takes slot of his UID
+int addUser(const std::string& login, uint64_t uniqueID = 0);
 
-// Check if UID is occupied
-bool uniqueIdentity(std::string uniqueID);
+// Removes user from indexes. Slot is reused when nobody can hold pointer to user
+void removeUser(int userNumber);
+
+// Clears slots of users removed before epoch whose polls aren't parked and gives them to new users
+void reuseUserSlots(uint64_t removedBefore);
+
+// Check if UID is free
+bool uniqueIdentity(uint64_t uniqueID);
 
 // Check if login is occupied
-bool uniqueUserLogin(std::string name);
+bool uniqueUserLogin(std::string_view name);
 
-// Gets number of user in users by UID
-int searchUserByUID(std::string uniqueID);
+// Gets number of user in users by UID. User of this shard is found by slot of UID without index
+int searchUserByUID(uint64_t uniqueID);
 
 // Gets number of user in users by Login
-int searchUserByLogin(std::string login);
+int searchUserByLogin(std::string_view login);
+
+// Gets user by UID. Returns nullptr if there is no such user
+User* getUserByUID(uint64_t uniqueID);
+
+// Adds specific message for user. Returns true if user's poll waits for messages
+bool addMessageToUser(User& user, const std::string& message);
 
-// Adds specific message for user
-void addMessageToUser(int userNumber, std::string message);
+// Takes all messages of user separated by kMessageDelimiter. Returns number of messages
+int takeUserMessages(User& user, std::string& messages);
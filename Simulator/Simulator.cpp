@@ -0,0 +1,315 @@
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+
+#include "ServerConnection.h"
+#include "Rules.h"
+#include "Bot.h"
+
+// Offline games between targeting strategies with the same fields and shot rules as server, without networking.
+// Player is strategy with fleet layout, every pair of players (and every player with himself) plays --games games,
+// first move goes to both players in turn. Games are spread across threads, every thread has own generator.
+// Length of game is number of shots of winner.
+// Usage: Simulator [--games N] [--threads T] [--seed S] [--players strategy:layout,...]
+// Strategies: density (server bot), hunt (random shots, then cells next to damaged ship), random.
+// Layouts: random, edges (ships along field borders while they fit)
+
+typedef std::chrono::steady_clock Clock;
+
+const int kMaxGameLength = kFieldSize * kFieldSize;
+const int kLengthBucket = 10; // Width of bucket of game length histogram
+
+enum Strategy { kDensityStrategy, kHuntStrategy, kRandomStrategy };
+enum Layout { kRandomLayout, kEdgesLayout };
+
+const char* const kStrategyNames[] = { "density", "hunt", "random" };
+const char* const kLayoutNames[] = { "random", "edges" };
+
+typedef struct structSimPlayer {
+    Strategy strategy;
+    Layout layout;
+    std::string name;
+} SimPlayer;
+
+// Options of simulation
+typedef struct structSimOptions {
+    long long games = 10000; // Games of every pair of players
+    int threads = (std::max)((int)std::thread::hardware_concurrency(), 1);
+    uint64_t seed = std::random_device{}();
+    std::vector<SimPlayer> players;
+} SimOptions;
+
+// Results of pair of players. Every thread keeps own results, they are merged at the end
+typedef struct structMatchStats {
+    long long games = 0;
+    long long wins[2] = {};
+    long long lengths[kMaxGameLength + 1] = {}; // Number of games of every length
+} MatchStats;
+
+// ===========================================================================================
+//
+//                                       Players
+//
+// ===========================================================================================
+
+// Parses player "strategy:layout", layout can be omitted. Returns false if name is unknown
+bool parsePlayer(const std::string& text, SimPlayer& player) {
+    size_t colon = text.find(':');
+    std::string strategy = text.substr(0, colon), layout = colon == std::string::npos ? "random" : text.substr(colon + 1);
+
+    auto strategyName = std::find(std::begin(kStrategyNames), std::end(kStrategyNames), strategy);
+    auto layoutName = std::find(std::begin(kLayoutNames), std::end(kLayoutNames), layout);
+    if (strategyName == std::end(kStrategyNames) || layoutName == std::end(kLayoutNames))
+        return false;
+
+    player.strategy = (Strategy)(strategyName - std::begin(kStrategyNames));
+    player.layout = (Layout)(layoutName - std::begin(kLayoutNames));
+    player.name = strategy + ":" + layout;
+    return true;
+}
+
+// Gets cells on borders of field
+Board edgeCells() {
+    Board edges;
+    for (int i = 0; i < kFieldSize; ++i)
+        edges |= cellBoard(0, i) | cellBoard(kFieldSize - 1, i) | cellBoard(i, 0) | cellBoard(i, kFieldSize - 1);
+    return edges;
+}
+
+// Places fleet of layout
+Board layoutFleet(Layout layout) {
+    static const Board edges = edgeCells();
+    return layout == kEdgesLayout ? randomFleet(edges) : randomFleet();
+}
+
+// Chooses cell for shot at enemy field. Strategy sees only hits, misses and sunk ships.
+// Returns row * kFieldSize + column
+int chooseShot(Strategy strategy, const PlayerField& enemy) {
+    if (strategy == kDensityStrategy)
+        return chooseBotShot(enemy.hits, enemy.misses, enemy.sunk);
+
+    Board unknown = boardCells() & ~enemy.hits & ~enemy.misses;
+    Board candidates = unknown;
+    if (strategy == kHuntStrategy) {
+        // Cells around sunk ships are sea
+        Board wounded = enemy.hits & ~enemy.sunk;
+        candidates &= ~neighbourCells(enemy.sunk);
+        if (wounded.any() && (candidates & sideNeighbourCells(wounded)).any())
+            candidates &= sideNeighbourCells(wounded);
+        if (candidates.none())
+            candidates = unknown;
+    }
+
+    int cell = randomCell(candidates);
+    return cell / kBoardStride * kFieldSize + cell % kBoardStride;
+}
+
+// ===========================================================================================
+//
+//                                     Simulation
+//
+// ===========================================================================================
+
+// Plays one game. Returns number of winner, his shots are put to length
+int playGame(const SimPlayer& first, const SimPlayer& second, int& length) {
+    const SimPlayer* players[2] = { &first, &second };
+    PlayerField fields[2];
+    for (int i = 0; i < 2; ++i)
+        placeFleet(fields[i], layoutFleet(players[i]->layout));
+
+    int shots[2] = {}, mover = 0;
+    while (true) {
+        PlayerField& enemy = fields[1 - mover];
+        int cell = chooseShot(players[mover]->strategy, enemy);
+        int result = shootAt(enemy, cell / kFieldSize, cell % kFieldSize);
+        ++shots[mover];
+
+        if (enemy.aliveCells == 0) {
+            length = shots[mover];
+            return mover;
+        }
+        if (result == kDamagedSea)
+            mover = 1 - mover;
+    }
+}
+
+// Thread procedure. Plays every game whose number gives thread number
+void runGames(int threadNumber, const SimOptions& options, const std::vector<std::pair<int, int>>& matches,
+    std::vector<MatchStats>& stats) {
+    seedBot(options.seed + threadNumber);
+
+    for (size_t match = 0; match < matches.size(); ++match) {
+        const SimPlayer& playerA = options.players[matches[match].first];
+        const SimPlayer& playerB = options.players[matches[match].second];
+        MatchStats& matchStats = stats[match];
+
+        for (long long game = threadNumber; game < options.games; game += options.threads) {
+            // First move goes to players in turn
+            bool isSwapped = game % 2 == 1;
+            int length;
+            int winner = isSwapped ? 1 - playGame(playerB, playerA, length) : playGame(playerA, playerB, length);
+
+            ++matchStats.games;
+            ++matchStats.wins[winner];
+            ++matchStats.lengths[length];
+        }
+    }
+}
+
+// ===========================================================================================
+//
+//                                       Report
+//
+// ===========================================================================================
+
+// Length at percentile of games
+int lengthPercentile(const MatchStats& stats, double rank) {
+    long long target = (std::max)((long long)(rank * stats.games + 0.5), 1LL), seen = 0;
+    for (int length = 0; length <= kMaxGameLength; ++length) {
+        seen += stats.lengths[length];
+        if (seen >= target)
+            return length;
+    }
+    return kMaxGameLength;
+}
+
+// Print win rates and lengths of every pair and histogram of lengths of all games
+void printReport(const SimOptions& options, const std::vector<std::pair<int, int>>& matches,
+    const std::vector<MatchStats>& results, double seconds) {
+    MatchStats total;
+    for (const MatchStats& match : results) {
+        total.games += match.games;
+        for (int length = 0; length <= kMaxGameLength; ++length)
+            total.lengths[length] += match.lengths[length];
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Time: " << seconds << " s, " << options.threads << " threads" << std::endl;
+    std::cout << "Games: " << total.games << " (" << total.games / seconds << " games/s)" << std::endl << std::endl;
+
+    std::cout << "Player A        Player B           Games  A wins %   Mean  p10  p50  p90  Max" << std::endl;
+    for (size_t match = 0; match < matches.size(); ++match) {
+        const MatchStats& stats = results[match];
+        if (stats.games == 0)
+            continue;
+
+        double sum = 0;
+        for (int length = 0; length <= kMaxGameLength; ++length)
+            sum += (double)length * stats.lengths[length];
+
+        std::cout << std::left << std::setw(16) << options.players[matches[match].first].name
+            << std::setw(16) << options.players[matches[match].second].name << std::right
+            << std::setw(9) << stats.games
+            << std::setw(10) << 100.0 * stats.wins[0] / stats.games
+            << std::setw(7) << sum / stats.games
+            << std::setw(5) << lengthPercentile(stats, 0.1)
+            << std::setw(5) << lengthPercentile(stats, 0.5)
+            << std::setw(5) << lengthPercentile(stats, 0.9)
+            << std::setw(5) << lengthPercentile(stats, 1.0) << std::endl;
+    }
+
+    std::cout << std::endl << "Shots of winner, all games:" << std::endl;
+    for (int bucket = 0; bucket <= kMaxGameLength; bucket += kLengthBucket) {
+        long long games = 0;
+        for (int length = bucket; length < bucket + kLengthBucket && length <= kMaxGameLength; ++length)
+            games += total.lengths[length];
+        if (games == 0)
+            continue;
+
+        double share = 100.0 * games / total.games;
+        std::cout << std::setw(4) << bucket << "-" << std::left << std::setw(4) << bucket + kLengthBucket - 1
+            << std::right << std::setw(6) << share << "% " << std::string((size_t)(share / 2), '#') << std::endl;
+    }
+}
+
+// Print options of simulator
+void printUsage() {
+    std::cout << "Usage: Simulator [--games N] [--threads T] [--seed S] [--players strategy:layout,...]" << std::endl;
+    std::cout << "Strategies: density, hunt, random. Layouts: random, edges" << std::endl;
+}
+
+// Parses unsigned number. Returns false if text is not a number
+bool parseOption(const char* text, uint64_t& value) {
+    char* end;
+    value = std::strtoull(text, &end, 10);
+    return *text >= '0' && *text <= '9' && *end == '\0';
+}
+
+int main(int argc, char* argv[]) {
+    SimOptions options;
+    std::string players = "density:random,hunt:random,random:random,density:edges";
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument == "--help") {
+            printUsage();
+            return 0;
+        }
+
+        // Typo or missing value would give experiment with defaults, so it stops simulator
+        bool isOption = argument == "--games" || argument == "--threads" || argument == "--seed" || argument == "--players";
+        uint64_t value = 0;
+        if (!isOption || i + 1 >= argc || (argument != "--players" && !parseOption(argv[i + 1], value))) {
+            std::cout << "Wrong argument " << argument << std::endl;
+            printUsage();
+            return 1;
+        }
+
+        ++i;
+        if (argument == "--games")
+            options.games = (long long)value;
+        else if (argument == "--threads")
+            options.threads = (std::max)((int)value, 1);
+        else if (argument == "--seed")
+            options.seed = value;
+        else
+            players = argv[i];
+    }
+
+    for (size_t start = 0; start < players.size();) {
+        size_t end = (std::min)(players.find(',', start), players.size());
+        SimPlayer player;
+        if (!parsePlayer(players.substr(start, end - start), player)) {
+            std::cout << "Unknown player " << players.substr(start, end - start) << std::endl;
+            return 1;
+        }
+        options.players.push_back(player);
+        start = end + 1;
+    }
+
+    std::vector<std::pair<int, int>> matches;
+    for (int a = 0; a < (int)options.players.size(); ++a)
+        for (int b = a; b < (int)options.players.size(); ++b)
+            matches.emplace_back(a, b);
+
+    std::cout << "Playing " << options.games << " games for each of " << matches.size() << " pairs in "
+        << options.threads << " threads, seed " << options.seed << std::endl;
+
+    std::vector<std::vector<MatchStats>> stats(options.threads, std::vector<MatchStats>(matches.size()));
+    std::vector<std::thread> workers;
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < options.threads; ++i)
+        workers.emplace_back(runGames, i, std::cref(options), std::cref(matches), std::ref(stats[i]));
+    for (std::thread& worker : workers)
+        worker.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<MatchStats> results(matches.size());
+    for (std::vector<MatchStats>& threadStats : stats)
+        for (size_t match = 0; match < matches.size(); ++match) {
+            results[match].games += threadStats[match].games;
+            for (int i = 0; i < 2; ++i)
+                results[match].wins[i] += threadStats[match].wins[i];
+            for (int length = 0; length <= kMaxGameLength; ++length)
+                results[match].lengths[length] += threadStats[match].lengths[length];
+        }
+
+    printReport(options, matches, results, seconds);
+    return 0;
+}